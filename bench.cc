@@ -1,17 +1,34 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
 
+#include "bench_util.h"
+#include "include/rs/disk_index.h"
+#include "include/rs/instrumentation.h"
 #include "include/rs/multi_map.h"
+#include "include/rs/parallel_builder.h"
+#include "include/rs/snapshot_handle.h"
+#include "include/rs/static_radix_spline.h"
+#include "include/rs/tuner.h"
+#include "latency_histogram.h"
+#include "perf_counters.h"
+#include "thread_util.h"
 
 using namespace std;
 
 namespace rs_manual_tuning {
 
-// Returns <num_radix_bits, max_error>
-pair<uint64_t, uint64_t> GetTuning(const string& data_filename,
-                                   uint32_t size_scale) {
+// Stores <num_radix_bits, max_error> in `tuning`. Returns false if there is
+// no config for the dataset.
+bool GetTuning(const string& data_filename, uint32_t size_scale,
+               pair<uint64_t, uint64_t>* tuning) {
   assert(size_scale >= 1 && size_scale <= 10);
 
   string dataset = data_filename;
@@ -27,216 +44,234 @@ pair<uint64_t, uint64_t> GetTuning(const string& data_filename,
   if (dataset == "normal_200M_uint32") {
     Configs configs = {{10, 6}, {15, 1}, {16, 1}, {18, 1}, {20, 1},
                        {21, 1}, {24, 1}, {25, 1}, {26, 1}, {26, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "normal_200M_uint64") {
     Configs configs = {{14, 2}, {16, 1}, {16, 1}, {20, 1}, {22, 1},
                        {24, 1}, {26, 1}, {26, 1}, {28, 1}, {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "lognormal_200M_uint32") {
     Configs configs = {{12, 20}, {16, 3}, {16, 2}, {18, 1}, {20, 1},
                        {22, 1},  {24, 1}, {24, 1}, {26, 1}, {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "lognormal_200M_uint64") {
     Configs configs = {{12, 3}, {18, 1}, {18, 1}, {20, 1}, {22, 1},
                        {24, 1}, {26, 1}, {26, 1}, {28, 1}, {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "uniform_dense_200M_uint32") {
     Configs configs = {{4, 2},  {16, 2}, {18, 1}, {20, 1}, {20, 1},
                        {22, 2}, {24, 1}, {26, 3}, {26, 3}, {28, 2}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "uniform_dense_200M_uint64") {
     Configs configs = {{4, 2},  {16, 1}, {16, 1}, {20, 1}, {22, 1},
                        {24, 1}, {24, 1}, {26, 1}, {28, 1}, {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "uniform_dense_200M_uint64") {
     Configs configs = {{4, 2},  {16, 1}, {16, 1}, {20, 1}, {22, 1},
                        {24, 1}, {24, 1}, {26, 1}, {28, 1}, {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "uniform_sparse_200M_uint32") {
     Configs configs = {{12, 220}, {14, 100}, {14, 80}, {16, 30}, {18, 20},
                        {20, 10},  {20, 8},   {20, 5},  {24, 3},  {26, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "uniform_sparse_200M_uint64") {
     Configs configs = {{12, 150}, {14, 70}, {16, 50}, {18, 20}, {20, 20},
                        {20, 9},   {20, 5},  {24, 3},  {26, 2},  {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   // Books (or amazon in the paper)
   if (dataset == "books_200M_uint32") {
     Configs configs = {{14, 250}, {14, 250}, {16, 190}, {18, 80}, {18, 50},
                        {22, 20},  {22, 9},   {22, 8},   {24, 3},  {28, 2}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "books_200M_uint64") {
     Configs configs = {{12, 380}, {16, 170}, {16, 110}, {20, 50}, {20, 30},
                        {22, 20},  {22, 10},  {24, 3},   {26, 3},  {28, 2}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "books_400M_uint64") {
     Configs configs = {{16, 220}, {16, 220}, {18, 160}, {20, 60}, {20, 40},
                        {22, 20},  {22, 7},   {26, 3},   {28, 2},  {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "books_600M_uint64") {
     Configs configs = {{18, 330}, {18, 330}, {18, 190}, {20, 70}, {22, 50},
                        {22, 20},  {24, 7},   {26, 3},   {28, 2},  {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "books_800M_uint64") {
     Configs configs = {{18, 320}, {18, 320}, {18, 200}, {22, 80}, {22, 60},
                        {22, 20},  {24, 9},   {26, 3},   {28, 3},  {28, 3}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   // Facebook
   if (dataset == "fb_200M_uint64") {
     Configs configs = {{8, 140}, {8, 140}, {8, 140}, {8, 140}, {10, 90},
                        {22, 90}, {24, 70}, {26, 80}, {26, 7},  {28, 80}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   // OSM
   if (dataset == "osm_cellids_200M_uint64") {
     Configs configs = {{20, 160}, {20, 160}, {20, 160}, {20, 160}, {20, 80},
                        {24, 40},  {24, 20},  {26, 8},   {26, 3},   {28, 2}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "osm_cellids_400M_uint64") {
     Configs configs = {{20, 190}, {20, 190}, {20, 190}, {20, 190}, {22, 80},
                        {24, 20},  {26, 20},  {26, 10},  {28, 6},   {28, 2}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "osm_cellids_600M_uint64") {
     Configs configs = {{20, 190}, {20, 190}, {20, 190}, {22, 180}, {22, 100},
                        {24, 20},  {26, 20},  {28, 7},   {28, 5},   {28, 2}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   if (dataset == "osm_cellids_800M_uint64") {
     Configs configs = {{22, 190}, {22, 190}, {22, 190}, {22, 190}, {24, 190},
                        {26, 30},  {26, 20},  {28, 7},   {28, 5},   {28, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
   // Wiki
   if (dataset == "wiki_ts_200M_uint64") {
     Configs configs = {{14, 100}, {14, 100}, {16, 60}, {18, 20}, {20, 20},
                        {20, 9},   {20, 5},   {22, 3},  {26, 2},  {26, 1}};
-    return configs[10 - size_scale];
+    *tuning = configs[10 - size_scale];
+    return true;
   }
 
-  cerr << "No tuning config for this dataset" << endl;
-  throw;
+  return false;
 }
 }  // namespace rs_manual_tuning
 
-namespace util {
-
-// Loads values from binary file into vector.
-template <typename T>
-static vector<T> load_data(const string& filename, bool print = true) {
-  vector<T> data;
-  ifstream in(filename, ios::binary);
-  if (!in.is_open()) {
-    cerr << "unable to open " << filename << endl;
-    exit(EXIT_FAILURE);
-  }
-  // Read size.
-  uint64_t size;
-  in.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
-  data.resize(size);
-  // Read values.
-  in.read(reinterpret_cast<char*>(data.data()), size * sizeof(T));
-
-  return data;
-}
-
-// Generates deterministic values for keys.
-template <class KeyType>
-static vector<pair<KeyType, uint64_t>> add_values(const vector<KeyType>& keys) {
-  vector<pair<KeyType, uint64_t>> result;
-  result.reserve(keys.size());
-
-  for (uint64_t i = 0; i < keys.size(); ++i) {
-    pair<KeyType, uint64_t> row;
-    row.first = keys[i];
-    row.second = i;
-
-    result.push_back(row);
-  }
-  return result;
-}
-
-}  // namespace util
-
 namespace {
 
-template <class KeyType, class ValueType>
+template <class KeyType, class ValueType,
+          class SearchPolicy = rs::BinarySearch>
 class NonOwningMultiMap {
  public:
   using element_type = pair<KeyType, ValueType>;
 
   NonOwningMultiMap(const vector<element_type>& elements,
-                    size_t num_radix_bits = 18, size_t max_error = 32)
+                    size_t num_radix_bits = 18, size_t max_error = 32,
+                    rs::SplineLayout spline_layout = rs::SplineLayout::kCompact,
+                    rs::RadixTableEncoding radix_table_encoding =
+                        rs::RadixTableEncoding::kPlain,
+                    rs::HugePages huge_pages = rs::HugePages::kNone,
+                    rs::ErrorBounds error_bounds = rs::ErrorBounds::kGlobal)
       : data_(elements) {
     assert(elements.size() > 0);
 
     // Create spline builder.
     const auto min_key = data_.front().first;
     const auto max_key = data_.back().first;
-    rs::Builder<KeyType> rsb(min_key, max_key, num_radix_bits, max_error);
+    rs::Builder<KeyType> rsb(min_key, max_key, num_radix_bits, max_error,
+                             spline_layout, radix_table_encoding, huge_pages,
+                             error_bounds);
 
     // Build the radix spline.
-    for (const auto& iter : data_) {
-      rsb.AddKey(iter.first);
-    }
+    rsb.AddKeys(data_.begin(), data_.end(), GetKey());
     rs_ = rsb.Finalize();
   }
 
   typename vector<element_type>::const_iterator lower_bound(KeyType key) const {
-    rs::SearchBound bound = rs_.GetSearchBound(key);
-    return ::lower_bound(data_.begin() + bound.begin, data_.begin() + bound.end,
-                         key, [](const element_type& lhs, const KeyType& rhs) {
-                           return lhs.first < rhs;
-                         });
+    return data_.begin() +
+           rs_.template LowerBound<SearchPolicy>(data_.begin(), key, GetKey());
   }
 
   uint64_t sum_up(KeyType key) const {
-    uint64_t result = 0;
-    auto iter = lower_bound(key);
-    while (iter != data_.end() && iter->first == key) {
-      result += iter->second;
-      ++iter;
+    const pair<size_t, size_t> range =
+        rs_.template EqualRange<SearchPolicy>(data_.begin(), key, GetKey());
+    return sum(range.first, range.second);
+  }
+
+  // Batched `sum_up`, overlaps the cache misses of independent lookups.
+  void sum_up_batch(const KeyType* keys, size_t num_keys,
+                    uint64_t* sums) const {
+    constexpr size_t kBatchSize = rs::RadixSpline<KeyType>::kBatchSize;
+    rs::SearchBound bounds[kBatchSize];
+    double estimates[kBatchSize];
+    for (size_t offset = 0; offset < num_keys; offset += kBatchSize) {
+      const size_t batch_size = min(kBatchSize, num_keys - offset);
+      rs_.GetSearchBounds(keys + offset, batch_size, bounds, estimates);
+      for (size_t i = 0; i < batch_size; ++i)
+        __builtin_prefetch(data_.data() + static_cast<size_t>(estimates[i]));
+      // Same duplicate handling as `sum_up`.
+      for (size_t i = 0; i < batch_size; ++i) {
+        const pair<size_t, size_t> range =
+            rs_.template EqualRangeWithin<SearchPolicy>(
+                data_.begin(), bounds[i], estimates[i], keys[offset + i],
+                GetKey());
+        sums[offset + i] = sum(range.first, range.second);
+      }
     }
-    return result;
+  }
+
+  rs::SearchBound GetSearchBound(KeyType key) const {
+    return rs_.GetSearchBound(key);
   }
 
   size_t GetSizeInByte() const { return rs_.GetSize(); }
 
  private:
+  struct GetKey {
+    KeyType operator()(const element_type& element) const {
+      return element.first;
+    }
+  };
+
+  // Sums up the values in [begin, end), without per-element key checks.
+  uint64_t sum(size_t begin, size_t end) const {
+    uint64_t result = 0;
+    for (size_t i = begin; i < end; ++i) result += data_[i].second;
+    return result;
+  }
+
   const vector<element_type>& data_;
   rs::RadixSpline<KeyType> rs_;
 };
@@ -247,28 +282,787 @@ struct Lookup {
   uint64_t value;
 };
 
+// Runs the lookups in batches and returns the elapsed time in ns.
+template <class KeyType>
+uint64_t RunBatched(const NonOwningMultiMap<KeyType, uint64_t>& map,
+                    const vector<Lookup<KeyType>>& lookups,
+                    const vector<KeyType>& lookup_keys) {
+  vector<uint64_t> sums(lookups.size());
+  auto lookup_begin = chrono::high_resolution_clock::now();
+  map.sum_up_batch(lookup_keys.data(), lookup_keys.size(), sums.data());
+  auto lookup_end = chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < lookups.size(); ++i) {
+    if (sums[i] != lookups[i].value) {
+      cerr << "wrong result!" << endl;
+      throw "error";
+    }
+  }
+  return chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
+      .count();
+}
+
+// Prints the percentiles of `histogram` in ns, prefixed by `prefix`.
+void PrintPercentiles(const string& prefix,
+                      const util::LatencyHistogram& histogram) {
+  const double ticks_per_ns = util::ticks_per_ns();
+  cout << " " << prefix << "count: " << histogram.Count();
+  for (const auto& percentile : {make_pair("p50", 0.5), make_pair("p90", 0.9),
+                                 make_pair("p99", 0.99),
+                                 make_pair("p999", 0.999)}) {
+    cout << " " << prefix << percentile.first << "_ns: "
+         << static_cast<uint64_t>(histogram.Percentile(percentile.second) /
+                                  ticks_per_ns);
+  }
+  cout << " " << prefix
+       << "max_ns: " << static_cast<uint64_t>(histogram.Max() / ticks_per_ns);
+}
+
+// Times each lookup individually and reports the latency percentiles. If the
+// library is compiled with `RS_INSTRUMENT_LOOKUPS`, additionally breaks them
+// down by the path the lookups took, see `rs::LookupTrace`.
+template <class KeyType>
+void RunLatencies(const NonOwningMultiMap<KeyType, uint64_t>& map,
+                  const vector<Lookup<KeyType>>& lookups,
+                  size_t num_radix_bits, size_t max_error) {
+  util::LatencyHistogram all;
+#ifdef RS_INSTRUMENT_LOOKUPS
+  // Number of duplicates from which on a lookup counts as a long run.
+  constexpr size_t kLongRun = 64;
+  util::LatencyHistogram clamped, linear_segment, binary_segment, fallback,
+      long_run;
+  rs::LookupTrace trace;
+  rs::SetLookupTrace(&trace);
+#endif
+  for (const Lookup<KeyType>& lookup_iter : lookups) {
+#ifdef RS_INSTRUMENT_LOOKUPS
+    trace = rs::LookupTrace();
+#endif
+    const uint64_t begin = util::read_ticks();
+    const uint64_t sum = map.sum_up(lookup_iter.key);
+    const uint64_t ticks = util::read_ticks() - begin;
+    if (sum != lookup_iter.value) {
+      cerr << "wrong result!" << endl;
+      throw "error";
+    }
+    all.Record(ticks);
+#ifdef RS_INSTRUMENT_LOOKUPS
+    if (trace.clamped) {
+      clamped.Record(ticks);
+    } else if (trace.binary_segment_search) {
+      binary_segment.Record(ticks);
+    } else {
+      linear_segment.Record(ticks);
+    }
+    if (trace.fallback) fallback.Record(ticks);
+    if (trace.equal_range_size >= kLongRun) long_run.Record(ticks);
+#endif
+  }
+
+  cout << "LATENCY:"
+       << " radix_bit_count: " << num_radix_bits
+       << " spline_error: " << max_error;
+  PrintPercentiles("", all);
+#ifdef RS_INSTRUMENT_LOOKUPS
+  rs::SetLookupTrace(nullptr);
+  PrintPercentiles("clamped_", clamped);
+  PrintPercentiles("linear_segment_", linear_segment);
+  PrintPercentiles("binary_segment_", binary_segment);
+  PrintPercentiles("fallback_", fallback);
+  PrintPercentiles("long_run_", long_run);
+#endif
+  cout << endl;
+}
+
+// Returns the size of the anonymous memory of this process that is backed by
+// transparent huge pages in kB, or 0 if the kernel doesn't report it.
+uint64_t GetAnonHugePagesKb() {
+  ifstream smaps("/proc/self/smaps_rollup");
+  string field;
+  uint64_t kb = 0;
+  while (smaps >> field) {
+    if (field == "AnonHugePages:" && smaps >> kb) return kb;
+  }
+  return 0;
+}
+
+// Compares lookups on a spline with normal pages with the ones on a spline
+// whose radix table and spline arrays are backed by `huge_pages`, see
+// `rs::HugePages`. Both share the elements. Reports the dTLB misses (via perf
+// counters, "n/a" if unavailable) and the latency of each.
+template <class KeyType>
+void RunHugePages(const vector<pair<KeyType, uint64_t>>& elements,
+                  const vector<Lookup<KeyType>>& lookups,
+                  size_t num_radix_bits, size_t max_error,
+                  rs::HugePages huge_pages) {
+  using Map = NonOwningMultiMap<KeyType, uint64_t>;
+  for (const rs::HugePages mode : {rs::HugePages::kNone, huge_pages}) {
+    const uint64_t huge_kb_before = GetAnonHugePagesKb();
+    const Map map(elements, num_radix_bits, max_error,
+                  rs::SplineLayout::kCompact, rs::RadixTableEncoding::kPlain,
+                  mode);
+    const uint64_t huge_kb =
+        max(GetAnonHugePagesKb(), huge_kb_before) - huge_kb_before;
+
+    // Warm up the caches and fault in the pages.
+    for (const Lookup<KeyType>& lookup_iter : lookups) {
+      if (map.sum_up(lookup_iter.key) != lookup_iter.value) {
+        cerr << "wrong result!" << endl;
+        throw "error";
+      }
+    }
+
+    util::LatencyHistogram histogram;
+    util::PerfCounters counters;
+    counters.Start();
+    auto lookup_begin = chrono::high_resolution_clock::now();
+    for (const Lookup<KeyType>& lookup_iter : lookups) {
+      const uint64_t begin = util::read_ticks();
+      const uint64_t sum = map.sum_up(lookup_iter.key);
+      histogram.Record(util::read_ticks() - begin);
+      if (sum != lookup_iter.value) {
+        cerr << "wrong result!" << endl;
+        throw "error";
+      }
+    }
+    auto lookup_end = chrono::high_resolution_clock::now();
+    counters.Stop();
+    const uint64_t lookup_ns =
+        chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
+            .count();
+
+    const char* const kModes[] = {"none", "transparent", "explicit"};
+    cout << "HUGE_PAGES:"
+         << " radix_bit_count: " << num_radix_bits
+         << " spline_error: " << max_error
+         << " huge_pages: " << kModes[static_cast<int>(mode)]
+         << " used_memory[MB]: " << (map.GetSizeInByte() / 1000) / 1000.0
+         << " anon_huge_pages[MB]: " << huge_kb / 1000.0
+         << " ns/lookup: " << lookup_ns / lookups.size();
+    PrintPercentiles("", histogram);
+    cout << counters.Format("lookup", lookups.size()) << endl;
+  }
+}
+
+// Compares lookups with global error bounds with the ones with per-segment
+// error bounds, see `rs::ErrorBounds`. Reports the average width of the search
+// bounds of the lookups next to the latency.
+template <class KeyType>
+void RunErrorBounds(const vector<pair<KeyType, uint64_t>>& elements,
+                    const vector<Lookup<KeyType>>& lookups,
+                    size_t num_radix_bits, size_t max_error) {
+  using Map = NonOwningMultiMap<KeyType, uint64_t>;
+  for (const rs::ErrorBounds error_bounds :
+       {rs::ErrorBounds::kGlobal, rs::ErrorBounds::kPerSegment}) {
+    auto build_begin = chrono::high_resolution_clock::now();
+    const Map map(elements, num_radix_bits, max_error,
+                  rs::SplineLayout::kCompact, rs::RadixTableEncoding::kPlain,
+                  rs::HugePages::kNone, error_bounds);
+    auto build_end = chrono::high_resolution_clock::now();
+    uint64_t width = 0;
+    for (const Lookup<KeyType>& lookup_iter : lookups) {
+      const rs::SearchBound bound = map.GetSearchBound(lookup_iter.key);
+      width += bound.end - bound.begin;
+    }
+
+    auto lookup_begin = chrono::high_resolution_clock::now();
+    for (const Lookup<KeyType>& lookup_iter : lookups) {
+      if (map.sum_up(lookup_iter.key) != lookup_iter.value) {
+        cerr << "wrong result!" << endl;
+        throw "error";
+      }
+    }
+    auto lookup_end = chrono::high_resolution_clock::now();
+    const uint64_t build_ns =
+        chrono::duration_cast<chrono::nanoseconds>(build_end - build_begin)
+            .count();
+    const uint64_t lookup_ns =
+        chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
+            .count();
+
+    cout << "ERROR_BOUNDS:"
+         << " radix_bit_count: " << num_radix_bits
+         << " spline_error: " << max_error << " error_bounds: "
+         << (error_bounds == rs::ErrorBounds::kGlobal ? "global"
+                                                      : "per_segment")
+         << " used_memory[MB]: " << (map.GetSizeInByte() / 1000) / 1000.0
+         << " build_time[s]: " << (build_ns / 1000 / 1000) / 1000.0
+         << " avg_bound_width: "
+         << static_cast<double>(width) / lookups.size()
+         << " ns/lookup: " << lookup_ns / lookups.size() << endl;
+  }
+}
+
+// Measures lookups of `rs::DiskIndex` on `data_file`, one by one and in
+// batches, with `num_cached_pages` cached pages and optionally direct I/O.
+// Reports the reads and bytes read per lookup next to the latency.
+template <class KeyType>
+void RunDisk(const string& data_file, const vector<KeyType>& keys,
+             const vector<Lookup<KeyType>>& lookups, size_t num_radix_bits,
+             size_t max_error, size_t num_cached_pages, bool direct_io) {
+  // Lookups per batch.
+  constexpr size_t kBatchSize = 1024;
+  rs::DiskIndex<KeyType> index;
+  if (!index.Open(data_file, num_radix_bits, max_error, num_cached_pages,
+                  direct_io)) {
+    cerr << "unable to open " << data_file << " for disk lookups" << endl;
+    throw "error";
+  }
+  const auto check = [&](KeyType key, size_t position) {
+    if (position >= keys.size() || keys[position] != key ||
+        (position > 0 && keys[position - 1] == key)) {
+      cerr << "wrong result!" << endl;
+      throw "error";
+    }
+  };
+
+  vector<KeyType> lookup_keys;
+  lookup_keys.reserve(lookups.size());
+  for (const Lookup<KeyType>& lookup_iter : lookups)
+    lookup_keys.push_back(lookup_iter.key);
+
+  auto lookup_begin = chrono::high_resolution_clock::now();
+  for (const KeyType key : lookup_keys) {
+    size_t position;
+    if (!index.LowerBound(key, &position)) throw "error";
+    check(key, position);
+  }
+  auto lookup_end = chrono::high_resolution_clock::now();
+  const rs::DiskStats stats = index.stats();
+  const uint64_t lookup_ns =
+      chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
+          .count();
+
+  index.ResetStats();
+  vector<size_t> positions(kBatchSize);
+  auto batch_begin = chrono::high_resolution_clock::now();
+  for (size_t offset = 0; offset < lookup_keys.size(); offset += kBatchSize) {
+    const size_t batch_size = min(kBatchSize, lookup_keys.size() - offset);
+    if (!index.LowerBoundBatch(lookup_keys.data() + offset, batch_size,
+                               positions.data()))
+      throw "error";
+    for (size_t i = 0; i < batch_size; ++i)
+      check(lookup_keys[offset + i], positions[i]);
+  }
+  auto batch_end = chrono::high_resolution_clock::now();
+  const rs::DiskStats batch_stats = index.stats();
+  const uint64_t batch_ns =
+      chrono::duration_cast<chrono::nanoseconds>(batch_end - batch_begin)
+          .count();
+
+  const double num_lookups = lookups.size();
+  cout << "DISK:"
+       << " radix_bit_count: " << num_radix_bits
+       << " spline_error: " << max_error
+       << " cached_pages: " << num_cached_pages << " direct_io: " << direct_io
+       << " used_memory[MB]: " << (index.spline().GetSize() / 1000) / 1000.0
+       << " ns/lookup: " << lookup_ns / lookups.size()
+       << " reads/lookup: " << stats.num_reads / num_lookups
+       << " bytes/lookup: " << stats.num_bytes_read / num_lookups
+       << " cache_hits/lookup: " << stats.num_cache_hits / num_lookups
+       << " batch_ns/lookup: " << batch_ns / lookups.size()
+       << " batch_reads/lookup: " << batch_stats.num_reads / num_lookups
+       << " batch_bytes/lookup: " << batch_stats.num_bytes_read / num_lookups
+       << endl;
+}
+
+// Measures the build time of `rs::ParallelBuilder` for 1, 2, 4, ... threads up
+// to the number of hardware threads.
+template <class KeyType>
+void RunBuildScaling(const vector<KeyType>& keys, size_t num_radix_bits,
+                     size_t max_error, rs::SplineLayout spline_layout,
+                     rs::RadixTableEncoding radix_table_encoding) {
+  const size_t max_threads = max(thread::hardware_concurrency(), 1u);
+  uint64_t single_thread_ns = 0;
+  for (size_t num_threads = 1;;
+       num_threads = min(2 * num_threads, max_threads)) {
+    rs::ParallelBuilder<KeyType> builder(num_threads, num_radix_bits, max_error,
+                                         spline_layout, radix_table_encoding);
+    auto build_begin = chrono::high_resolution_clock::now();
+    const rs::RadixSpline<KeyType> rs = builder.Build(keys.data(), keys.size());
+    auto build_end = chrono::high_resolution_clock::now();
+    const uint64_t build_ns =
+        chrono::duration_cast<chrono::nanoseconds>(build_end - build_begin)
+            .count();
+    if (num_threads == 1) single_thread_ns = build_ns;
+
+    cout << "BUILD_SCALING:"
+         << " radix_bit_count: " << num_radix_bits
+         << " spline_error: " << max_error << " threads: " << num_threads
+         << " used_memory[MB]: " << (rs.GetSize() / 1000) / 1000.0
+         << " build_time[s]: " << (build_ns / 1000 / 1000) / 1000.0
+         << " speedup: " << static_cast<double>(single_thread_ns) / build_ns
+         << endl;
+    if (num_threads == max_threads) break;
+  }
+}
+
+// Runs `num_readers` threads that look up `lookups` in a loop, while
+// `rebuild()` runs on the calling thread. Each reader calls `make_reader()`
+// once and then `sum_up(key)` on the returned function. Returns the lookups per
+// second.
+template <class KeyType, class MakeReader, class Rebuild>
+double MeasureReadThroughput(const vector<Lookup<KeyType>>& lookups,
+                             size_t num_readers, const MakeReader& make_reader,
+                             const Rebuild& rebuild) {
+  atomic<bool> done(false);
+  atomic<uint64_t> num_lookups(0);
+  vector<thread> readers;
+  auto begin = chrono::high_resolution_clock::now();
+  for (size_t i = 0; i < num_readers; ++i) {
+    readers.emplace_back([&, i]() {
+      auto sum_up = make_reader();
+      uint64_t num_reader_lookups = 0;
+      // Readers start at different offsets.
+      for (size_t j = i * lookups.size() / num_readers; !done.load();
+           j = (j + 1) % lookups.size(), ++num_reader_lookups) {
+        if (sum_up(lookups[j].key) != lookups[j].value) {
+          cerr << "wrong result!" << endl;
+          throw "error";
+        }
+      }
+      num_lookups += num_reader_lookups;
+    });
+  }
+  rebuild();
+  done = true;
+  for (auto& reader : readers) reader.join();
+  auto end = chrono::high_resolution_clock::now();
+  const double seconds =
+      chrono::duration_cast<chrono::nanoseconds>(end - begin).count() / 1e9;
+  return num_lookups / seconds;
+}
+
+// Measures the lookup throughput of concurrent readers while the map is
+// rebuilt and republished, once through `rs::SnapshotHandle` and once
+// through a mutex-protected `shared_ptr`.
+template <class KeyType>
+void RunConcurrentRebuilds(const vector<pair<KeyType, uint64_t>>& elements,
+                           const vector<Lookup<KeyType>>& lookups,
+                           size_t num_radix_bits, size_t max_error) {
+  using Map = NonOwningMultiMap<KeyType, uint64_t>;
+  constexpr size_t kNumRebuilds = 3;
+  const size_t num_readers = max(thread::hardware_concurrency(), 2u) - 1;
+
+  rs::SnapshotHandle<Map> handle(unique_ptr<const Map>(
+      new Map(elements, num_radix_bits, max_error)));
+  const double snapshot_lookups_per_second = MeasureReadThroughput(
+      lookups, num_readers,
+      [&]() {
+        auto reader =
+            make_shared<typename rs::SnapshotHandle<Map>::Reader>(&handle);
+        return [reader](KeyType key) {
+          const uint64_t sum = reader->Pin()->sum_up(key);
+          reader->Unpin();
+          return sum;
+        };
+      },
+      [&]() {
+        for (size_t i = 0; i < kNumRebuilds; ++i)
+          handle.Publish(unique_ptr<const Map>(
+              new Map(elements, num_radix_bits, max_error)));
+      });
+
+  mutex map_mutex;
+  shared_ptr<const Map> map =
+      make_shared<const Map>(elements, num_radix_bits, max_error);
+  const double mutex_lookups_per_second = MeasureReadThroughput(
+      lookups, num_readers,
+      [&]() {
+        return [&](KeyType key) {
+          shared_ptr<const Map> pinned_map;
+          {
+            lock_guard<mutex> lock(map_mutex);
+            pinned_map = map;
+          }
+          return pinned_map->sum_up(key);
+        };
+      },
+      [&]() {
+        for (size_t i = 0; i < kNumRebuilds; ++i) {
+          auto new_map =
+              make_shared<const Map>(elements, num_radix_bits, max_error);
+          lock_guard<mutex> lock(map_mutex);
+          map = move(new_map);
+        }
+      });
+
+  cout << "CONCURRENT_REBUILDS:"
+       << " radix_bit_count: " << num_radix_bits
+       << " spline_error: " << max_error << " readers: " << num_readers
+       << " rebuilds: " << kNumRebuilds
+       << " snapshot_lookups/s: " << snapshot_lookups_per_second
+       << " mutex_lookups/s: " << mutex_lookups_per_second << endl;
+}
+
+// Runs `num_threads` threads, pinned to cpus round-robin across the NUMA
+// `nodes`, that each look up their shard of `lookups` in the map of their node,
+// `maps[node % maps.size()]`. Returns the aggregate lookups per second and
+// stores the lookups per second of each thread in `thread_lookups_per_second`.
+template <class KeyType, class Map>
+double MeasurePinnedLookups(const vector<const Map*>& maps,
+                            const vector<vector<int>>& nodes,
+                            const vector<Lookup<KeyType>>& lookups,
+                            size_t num_threads,
+                            vector<double>* thread_lookups_per_second) {
+  // Passes over each shard, to run long enough for stable numbers.
+  constexpr size_t kNumRounds = 5;
+  atomic<size_t> num_ready(0);
+  atomic<bool> start(false);
+  thread_lookups_per_second->assign(num_threads, 0);
+  vector<thread> threads;
+  for (size_t i = 0; i < num_threads; ++i) {
+    threads.emplace_back([&, i]() {
+      const size_t node = i % nodes.size();
+      util::pin_thread(nodes[node][i / nodes.size() % nodes[node].size()]);
+      const Map& map = *maps[node % maps.size()];
+      const size_t shard_begin = i * lookups.size() / num_threads;
+      const size_t shard_end = (i + 1) * lookups.size() / num_threads;
+      ++num_ready;
+      while (!start.load()) this_thread::yield();
+      auto begin = chrono::high_resolution_clock::now();
+      for (size_t round = 0; round < kNumRounds; ++round) {
+        for (size_t j = shard_begin; j < shard_end; ++j) {
+          if (map.sum_up(lookups[j].key) != lookups[j].value) {
+            cerr << "wrong result!" << endl;
+            throw "error";
+          }
+        }
+      }
+      auto end = chrono::high_resolution_clock::now();
+      (*thread_lookups_per_second)[i] =
+          kNumRounds * (shard_end - shard_begin) /
+          (chrono::duration_cast<chrono::nanoseconds>(end - begin).count() /
+           1e9);
+    });
+  }
+  while (num_ready.load() < num_threads) this_thread::yield();
+  auto begin = chrono::high_resolution_clock::now();
+  start = true;
+  for (auto& thread : threads) thread.join();
+  auto end = chrono::high_resolution_clock::now();
+  const double seconds =
+      chrono::duration_cast<chrono::nanoseconds>(end - begin).count() / 1e9;
+  return kNumRounds * lookups.size() / seconds;
+}
+
+// A copy of the elements and a map on top of it, built by a thread pinned to
+// one NUMA node so that first-touch allocates both on that node.
+template <class KeyType>
+struct NodeReplica {
+  NodeReplica(const vector<pair<KeyType, uint64_t>>& elements,
+              size_t num_radix_bits, size_t max_error)
+      : elements(elements), map(this->elements, num_radix_bits, max_error) {}
+
+  const vector<pair<KeyType, uint64_t>> elements;
+  const NonOwningMultiMap<KeyType, uint64_t> map;
+};
+
+// Measures the lookup throughput of 1, 2, 4, ... pinned threads up to
+// `max_threads`, all sharing `map`, and with `numa_replicas` also with one
+// replica of the map per NUMA node.
+template <class KeyType>
+void RunLookupThreads(const NonOwningMultiMap<KeyType, uint64_t>& map,
+                      const vector<pair<KeyType, uint64_t>>& elements,
+                      const vector<Lookup<KeyType>>& lookups,
+                      size_t num_radix_bits, size_t max_error,
+                      size_t max_threads, bool numa_replicas) {
+  using Map = NonOwningMultiMap<KeyType, uint64_t>;
+  const vector<vector<int>> nodes = util::get_numa_nodes();
+
+  vector<unique_ptr<NodeReplica<KeyType>>> replicas(nodes.size());
+  if (numa_replicas) {
+    vector<thread> builders;
+    for (size_t node = 0; node < nodes.size(); ++node) {
+      builders.emplace_back([&, node]() {
+        util::pin_thread(nodes[node].front());
+        replicas[node].reset(
+            new NodeReplica<KeyType>(elements, num_radix_bits, max_error));
+      });
+    }
+    for (auto& builder : builders) builder.join();
+  }
+
+  for (const bool replicated : {false, true}) {
+    if (replicated && !numa_replicas) break;
+    vector<const Map*> maps;
+    if (replicated) {
+      for (const auto& replica : replicas) maps.push_back(&replica->map);
+    } else {
+      maps.push_back(&map);
+    }
+
+    double single_thread_lookups_per_second = 0;
+    vector<double> thread_lookups_per_second;
+    for (size_t num_threads = 1;;
+         num_threads = min(2 * num_threads, max_threads)) {
+      const double lookups_per_second = MeasurePinnedLookups(
+          maps, nodes, lookups, num_threads, &thread_lookups_per_second);
+      if (num_threads == 1)
+        single_thread_lookups_per_second = lookups_per_second;
+      cout << "LOOKUP_THREADS:"
+           << " radix_bit_count: " << num_radix_bits
+           << " spline_error: " << max_error
+           << " mode: " << (replicated ? "numa_replicas" : "shared")
+           << " numa_nodes: " << nodes.size() << " threads: " << num_threads
+           << " lookups/s: " << lookups_per_second << " min_thread_lookups/s: "
+           << *min_element(thread_lookups_per_second.begin(),
+                           thread_lookups_per_second.end())
+           << " max_thread_lookups/s: "
+           << *max_element(thread_lookups_per_second.begin(),
+                           thread_lookups_per_second.end())
+           << " scaling: "
+           << lookups_per_second / single_thread_lookups_per_second << endl;
+      if (num_threads == max_threads) break;
+    }
+  }
+}
+
+// Builds a map with `SearchPolicy` and returns the average lookup time in ns.
+template <class SearchPolicy, class KeyType>
+uint64_t MeasureSearchPolicy(const vector<pair<KeyType, uint64_t>>& elements,
+                             const vector<Lookup<KeyType>>& lookups,
+                             size_t num_radix_bits, size_t max_error) {
+  const NonOwningMultiMap<KeyType, uint64_t, SearchPolicy> map(
+      elements, num_radix_bits, max_error);
+  auto lookup_begin = chrono::high_resolution_clock::now();
+  for (const Lookup<KeyType>& lookup_iter : lookups) {
+    if (map.sum_up(lookup_iter.key) != lookup_iter.value) {
+      cerr << "wrong result!" << endl;
+      throw "error";
+    }
+  }
+  auto lookup_end = chrono::high_resolution_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
+             .count() /
+         lookups.size();
+}
+
+// Compares the last-mile search policies of search.h.
+template <class KeyType>
+void RunSearchPolicies(const vector<pair<KeyType, uint64_t>>& elements,
+                       const vector<Lookup<KeyType>>& lookups,
+                       size_t num_radix_bits, size_t max_error) {
+  cout << "SEARCH_POLICIES:"
+       << " radix_bit_count: " << num_radix_bits
+       << " spline_error: " << max_error << " binary_ns/lookup: "
+       << MeasureSearchPolicy<rs::BinarySearch>(elements, lookups,
+                                                num_radix_bits, max_error)
+       << " branchless_ns/lookup: "
+       << MeasureSearchPolicy<rs::BranchlessBinarySearch>(
+              elements, lookups, num_radix_bits, max_error)
+       << " exponential_ns/lookup: "
+       << MeasureSearchPolicy<rs::ExponentialSearch>(elements, lookups,
+                                                     num_radix_bits, max_error)
+       << " linear_ns/lookup: "
+       << MeasureSearchPolicy<rs::LinearSearch>(elements, lookups,
+                                                num_radix_bits, max_error)
+       << endl;
+}
+
+// Returns the average time in ns of looking up the position of each lookup
+// key in `keys` with `spline`. The lookup keys need to be in `keys`.
+template <class Spline, class KeyType>
+uint64_t MeasurePositionLookups(const Spline& spline,
+                                const vector<KeyType>& keys,
+                                const vector<Lookup<KeyType>>& lookups) {
+  auto lookup_begin = chrono::high_resolution_clock::now();
+  for (const Lookup<KeyType>& lookup_iter : lookups) {
+    const size_t position = spline.LowerBound(keys.data(), lookup_iter.key);
+    if (position >= keys.size() || keys[position] != lookup_iter.key) {
+      cerr << "wrong result!" << endl;
+      throw "error";
+    }
+  }
+  auto lookup_end = chrono::high_resolution_clock::now();
+  return chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
+             .count() /
+         lookups.size();
+}
+
+// Compares position lookups on the runtime `rs::RadixSpline` with the ones on
+// the model that `rs::DispatchStatic` picks, a `rs::StaticRadixSpline` if the
+// config is one of `rs::DefaultStaticConfigs`.
+template <class KeyType>
+void RunStaticDispatch(const vector<KeyType>& keys,
+                       const vector<Lookup<KeyType>>& lookups,
+                       size_t num_radix_bits, size_t max_error) {
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), num_radix_bits,
+                           max_error);
+  rsb.AddKeys(keys.data(), keys.data() + keys.size());
+  const rs::RadixSpline<KeyType> runtime_rs = rsb.Finalize();
+  // Warm up the caches.
+  MeasurePositionLookups(runtime_rs, keys, lookups);
+  const uint64_t runtime_ns = MeasurePositionLookups(runtime_rs, keys, lookups);
+
+  bool is_static = false;
+  uint64_t dispatched_ns = 0;
+  rs::DispatchStatic(runtime_rs, [&](const auto& spline) {
+    is_static = !is_same<decay_t<decltype(spline)>,
+                         rs::RadixSpline<KeyType>>::value;
+    dispatched_ns = MeasurePositionLookups(spline, keys, lookups);
+  });
+
+  cout << "STATIC_DISPATCH:"
+       << " radix_bit_count: " << num_radix_bits
+       << " spline_error: " << max_error << " static: " << is_static
+       << " runtime_ns/lookup: " << runtime_ns
+       << " dispatched_ns/lookup: " << dispatched_ns << endl;
+}
+
+// Returns the elements per second of `construct()`, which returns the size of
+// the map that it constructs.
+template <class Construct>
+double MeasureConstruction(size_t num_elements, const Construct& construct) {
+  auto begin = chrono::high_resolution_clock::now();
+  const size_t size = construct();
+  auto end = chrono::high_resolution_clock::now();
+  if (size != num_elements) {
+    cerr << "wrong result!" << endl;
+    throw "error";
+  }
+  return num_elements /
+         (chrono::duration_cast<chrono::nanoseconds>(end - begin).count() /
+          1e9);
+}
+
+// Measures the construction throughput of `rs::MultiMap` from shuffled
+// elements: the copy and comparison sort that the constructor used to do, the
+// copying constructor, and the constructor that takes over a vector, with one
+// and with all hardware threads for sorting.
+template <class KeyType>
+void RunConstruction(const vector<pair<KeyType, uint64_t>>& elements,
+                     size_t num_radix_bits, size_t max_error) {
+  using Map = rs::MultiMap<KeyType, uint64_t>;
+  using Element = pair<KeyType, uint64_t>;
+  vector<Element> shuffled = elements;
+  shuffle(shuffled.begin(), shuffled.end(), mt19937(42));
+  const size_t num_threads = max(thread::hardware_concurrency(), 1u);
+
+  const double push_back_sort = MeasureConstruction(elements.size(), [&]() {
+    vector<Element> data;
+    for (const Element& element : shuffled) data.push_back(element);
+    sort(data.begin(), data.end(), [](const Element& lhs, const Element& rhs) {
+      return lhs.first < rhs.first;
+    });
+    return Map(move(data), num_radix_bits, max_error).size();
+  });
+  const double copy = MeasureConstruction(elements.size(), [&]() {
+    return Map(shuffled.begin(), shuffled.end(), num_radix_bits, max_error)
+        .size();
+  });
+  // Taking over a vector consumes it, hence copy it outside of the timing.
+  const auto adopt = [&](size_t num_sort_threads) {
+    vector<Element> data = shuffled;
+    return MeasureConstruction(elements.size(), [&]() {
+      return Map(move(data), num_radix_bits, max_error, num_sort_threads)
+          .size();
+    });
+  };
+  const double adopt_single_thread = adopt(1);
+  const double adopt_all_threads = adopt(num_threads);
+
+  cout << "CONSTRUCTION:"
+       << " radix_bit_count: " << num_radix_bits
+       << " spline_error: " << max_error
+       << " push_back_sort_elements/s: " << push_back_sort
+       << " copy_elements/s: " << copy
+       << " adopt_elements/s: " << adopt_single_thread
+       << " threads: " << num_threads
+       << " adopt_parallel_elements/s: " << adopt_all_threads << endl;
+}
+
+// Returns the <num_radix_bits, max_error> configs to benchmark, from the
+// largest to the smallest model. Uses the manual tuning if available (unless
+// `--auto_tune` is set) and otherwise up to 10 Pareto-optimal configs of
+// `rs::Tuner`.
+template <class KeyType>
+vector<pair<uint64_t, uint64_t>> GetTunings(const string& data_file,
+                                            const vector<KeyType>& keys,
+                                            const util::Flags& flags) {
+  vector<pair<uint64_t, uint64_t>> tunings;
+  pair<uint64_t, uint64_t> tuning;
+  if (!flags.Has("auto_tune") &&
+      rs_manual_tuning::GetTuning(data_file, /*size_scale=*/1, &tuning)) {
+    for (uint32_t size_config = 1; size_config <= 10; ++size_config) {
+      rs_manual_tuning::GetTuning(data_file, size_config, &tuning);
+      tunings.push_back(tuning);
+    }
+    return tunings;
+  }
+
+  const rs::Tuner<KeyType> tuner(keys.data(), keys.size());
+  const vector<rs::TuningConfig>& configs = tuner.GetParetoConfigs();
+  const size_t num_tunings = min<size_t>(configs.size(), 10);
+  for (size_t i = num_tunings; i-- > 0;) {
+    // Spread the picks evenly across the Pareto front.
+    const size_t index =
+        (num_tunings == 1) ? 0 : i * (configs.size() - 1) / (num_tunings - 1);
+    tunings.emplace_back(configs[index].num_radix_bits,
+                         configs[index].max_error);
+  }
+  return tunings;
+}
+
 template <class KeyType>
-void Run(const string& data_file, const string lookup_file) {
+void Run(const string& data_file, const string lookup_file,
+         const util::Flags& flags) {
   // Load data
   vector<KeyType> keys = util::load_data<KeyType>(data_file);
   vector<pair<KeyType, uint64_t>> elements = util::add_values(keys);
   vector<Lookup<KeyType>> lookups =
       util::load_data<Lookup<KeyType>>(lookup_file);
 
-  for (uint32_t size_config = 1; size_config <= 10; ++size_config) {
+  // Batched lookups expect the lookup keys in a dense array.
+  const bool batch = flags.Has("batch");
+  const bool perf_counters = flags.Has("perf_counters");
+  const rs::SplineLayout spline_layout =
+      flags.Has("precomputed_slopes") ? rs::SplineLayout::kPrecomputedSlopes
+                                      : rs::SplineLayout::kCompact;
+  const rs::RadixTableEncoding radix_table_encoding =
+      flags.Has("compressed_radix_table") ? rs::RadixTableEncoding::kCompressed
+                                          : rs::RadixTableEncoding::kPlain;
+  const string huge_pages_mode = flags.Get("huge_pages", "transparent");
+  const rs::HugePages huge_pages = (huge_pages_mode == "explicit")
+                                       ? rs::HugePages::kExplicit
+                                       : rs::HugePages::kTransparent;
+  const size_t num_cached_pages =
+      flags.Get("disk", "").empty() ? 0 : flags.GetInt("disk", 0);
+  // Defaults to all cpus.
+  size_t max_lookup_threads = 0;
+  for (const vector<int>& cpus : util::get_numa_nodes())
+    max_lookup_threads += cpus.size();
+  if (!flags.Get("lookup_threads", "").empty())
+    max_lookup_threads = max<size_t>(flags.GetInt("lookup_threads", 1), 1);
+  vector<KeyType> lookup_keys;
+  if (batch) {
+    lookup_keys.reserve(lookups.size());
+    for (const Lookup<KeyType>& lookup_iter : lookups)
+      lookup_keys.push_back(lookup_iter.key);
+  }
+
+  const vector<pair<uint64_t, uint64_t>> tunings =
+      GetTunings(data_file, keys, flags);
+  for (uint32_t size_config = 1; size_config <= tunings.size();
+       ++size_config) {
     // Get the config for tuning
-    auto tuning = rs_manual_tuning::GetTuning(data_file, size_config);
+    const auto& tuning = tunings[size_config - 1];
 
     // Build RS
+    util::PerfCounters build_counters(perf_counters);
+    build_counters.Start();
     auto build_begin = chrono::high_resolution_clock::now();
     NonOwningMultiMap<KeyType, uint64_t> map(elements, tuning.first,
-                                             tuning.second);
+                                             tuning.second, spline_layout,
+                                             radix_table_encoding);
     auto build_end = chrono::high_resolution_clock::now();
+    build_counters.Stop();
     uint64_t build_ns =
         chrono::duration_cast<chrono::nanoseconds>(build_end - build_begin)
             .count();
 
     // Run queries
+    util::PerfCounters lookup_counters(perf_counters);
+    lookup_counters.Start();
     auto lookup_begin = chrono::high_resolution_clock::now();
     for (const Lookup<KeyType>& lookup_iter : lookups) {
       uint64_t sum = map.sum_up(lookup_iter.key);
@@ -278,6 +1072,7 @@ void Run(const string& data_file, const string lookup_file) {
       }
     }
     auto lookup_end = chrono::high_resolution_clock::now();
+    lookup_counters.Stop();
     uint64_t lookup_ns =
         chrono::duration_cast<chrono::nanoseconds>(lookup_end - lookup_begin)
             .count();
@@ -289,24 +1084,102 @@ void Run(const string& data_file, const string lookup_file) {
          << " size_config: " << size_config
          << " used_memory[MB]: " << (map.GetSizeInByte() / 1000) / 1000.0
          << " build_time[s]: " << (build_ns / 1000 / 1000) / 1000.0
-         << " ns/lookup: " << lookup_ns / lookups.size() << endl;
+         << " ns/lookup: " << lookup_ns / lookups.size();
+    if (batch) {
+      const uint64_t batch_ns = RunBatched(map, lookups, lookup_keys);
+      cout << " batch_ns/lookup: " << batch_ns / lookups.size();
+    }
+    if (perf_counters) {
+      cout << build_counters.Format("key", keys.size())
+           << lookup_counters.Format("lookup", lookups.size());
+    }
+    cout << endl;
+
+    if (flags.Has("build_scaling"))
+      RunBuildScaling(keys, tuning.first, tuning.second, spline_layout,
+                      radix_table_encoding);
+    if (flags.Has("concurrent_rebuilds"))
+      RunConcurrentRebuilds(elements, lookups, tuning.first, tuning.second);
+    if (flags.Has("search_policies"))
+      RunSearchPolicies(elements, lookups, tuning.first, tuning.second);
+    if (flags.Has("static_dispatch"))
+      RunStaticDispatch(keys, lookups, tuning.first, tuning.second);
+    if (flags.Has("latency"))
+      RunLatencies(map, lookups, tuning.first, tuning.second);
+    if (flags.Has("lookup_threads") || flags.Has("numa_replicas"))
+      RunLookupThreads(map, elements, lookups, tuning.first, tuning.second,
+                       max_lookup_threads, flags.Has("numa_replicas"));
+    if (flags.Has("huge_pages"))
+      RunHugePages(elements, lookups, tuning.first, tuning.second,
+                   huge_pages);
+    if (flags.Has("per_segment_errors"))
+      RunErrorBounds(elements, lookups, tuning.first, tuning.second);
+    if (flags.Has("disk"))
+      RunDisk(data_file, keys, lookups, tuning.first, tuning.second,
+              num_cached_pages, flags.Has("direct_io"));
   }
+  // Uses the defaults, the largest tunings spend most of the construction
+  // time on the radix table instead of on sorting.
+  if (flags.Has("construction"))
+    RunConstruction(elements, /*num_radix_bits=*/18, /*max_error=*/32);
+  // The tunings rarely match a static config, also compare the defaults.
+  if (flags.Has("static_dispatch"))
+    RunStaticDispatch(keys, lookups, /*num_radix_bits=*/18, /*max_error=*/32);
 }
 
 }  // namespace
 
 int main(int argc, char** argv) {
-  if (argc != 3) {
-    cerr << "usage: " << argv[0] << " <data_file> <lookup_file>" << endl;
+  if (argc < 3) {
+    cerr << "usage: " << argv[0]
+         << " <data_file> <lookup_file> [--batch] [--precomputed_slopes]"
+            " [--compressed_radix_table] [--build_scaling] [--auto_tune]"
+            " [--concurrent_rebuilds] [--search_policies] [--static_dispatch]"
+            " [--perf_counters] [--lookup_threads[=<max>]] [--numa_replicas]"
+            " [--latency] [--construction]"
+            " [--huge_pages[=transparent|explicit]]"
+            " [--disk[=<cached_pages>]] [--direct_io] [--per_segment_errors]"
+         << endl;
     throw;
   }
   const string data_file = argv[1];
   const string lookup_file = argv[2];
+  // --batch: additionally measures batched lookups.
+  // --precomputed_slopes: builds with `SplineLayout::kPrecomputedSlopes`.
+  // --compressed_radix_table: builds with `RadixTableEncoding::kCompressed`.
+  // --build_scaling: additionally measures multi-threaded build times.
+  // --auto_tune: uses `rs::Tuner` even if there is a manual tuning.
+  // --concurrent_rebuilds: additionally measures the lookup throughput of
+  //   concurrent readers while the map is rebuilt.
+  // --search_policies: additionally compares the last-mile search policies.
+  // --static_dispatch: additionally compares position lookups on
+  //   `rs::StaticRadixSpline` with the ones on `rs::RadixSpline`.
+  // --perf_counters: additionally reports hardware performance counters per
+  //   key built and per lookup, or "n/a" if they are unavailable.
+  // --lookup_threads[=<max>]: additionally measures the lookup throughput of
+  //   1, 2, 4, ... pinned threads up to <max> (all cpus by default), each on
+  //   its shard of the lookups.
+  // --numa_replicas: like --lookup_threads, and additionally with one replica
+  //   of the map per NUMA node instead of a shared one.
+  // --latency: additionally reports per-lookup latency percentiles, broken
+  //   down by lookup path if built with `-DRS_INSTRUMENT_LOOKUPS=ON`.
+  // --construction: additionally measures the construction throughput of
+  //   `rs::MultiMap` from unsorted elements.
+  // --huge_pages[=transparent|explicit]: additionally compares the dTLB misses
+  //   and latencies of lookups with the spline on normal and on huge pages
+  //   (transparent by default), see `rs::HugePages`.
+  // --disk[=<cached_pages>]: additionally measures lookups with the keys on
+  //   disk, see `rs::DiskIndex`, with <cached_pages> cached pages (none by
+  //   default).
+  // --direct_io: bypasses the operating system's page cache with --disk.
+  // --per_segment_errors: additionally compares lookups with global and with
+  //   per-segment error bounds, see `rs::ErrorBounds`.
+  const util::Flags flags(argc - 3, argv + 3);
 
   if (data_file.find("32") != string::npos) {
-    Run<uint32_t>(data_file, lookup_file);
+    Run<uint32_t>(data_file, lookup_file, flags);
   } else {
-    Run<uint64_t>(data_file, lookup_file);
+    Run<uint64_t>(data_file, lookup_file, flags);
   }
 
   return 0;
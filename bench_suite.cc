@@ -0,0 +1,375 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "include/rs/multi_map.h"
+
+using namespace std;
+
+// A self-contained benchmark suite over synthetic datasets. Every run is
+// reproducible from its flags alone and writes one CSV or JSON record per
+// <dataset, key type> pair, so that results can be tracked over time without
+// any data files.
+
+namespace {
+
+const char* const kDatasets[] = {"uniform_dense", "uniform_sparse", "normal",
+                                  "lognormal",     "zipf",
+                                  "clustered",     "long_runs"};
+
+// Generates `num_keys` sorted keys of `dataset`. Returns false if the dataset
+// is unknown.
+template <class KeyType>
+bool GenerateKeys(const string& dataset, size_t num_keys, uint64_t seed,
+                  vector<KeyType>* keys) {
+  mt19937_64 gen(seed);
+  const double max_key = numeric_limits<KeyType>::max();
+  // Clamps `value` to the key domain. For 64-bit keys, `max_key` rounds up to
+  // 2^64, which does not convert back to a key.
+  const auto to_key = [&](double value) -> KeyType {
+    if (value >= max_key) return numeric_limits<KeyType>::max();
+    return static_cast<KeyType>(max(0.0, value));
+  };
+  keys->clear();
+  keys->reserve(num_keys);
+
+  if (dataset == "uniform_dense") {
+    // Consecutive keys from a random start.
+    const KeyType start = uniform_int_distribution<KeyType>(
+        0, numeric_limits<KeyType>::max() - num_keys)(gen);
+    for (size_t i = 0; i < num_keys; ++i) keys->push_back(start + i);
+  } else if (dataset == "uniform_sparse") {
+    uniform_int_distribution<KeyType> distrib;
+    for (size_t i = 0; i < num_keys; ++i) keys->push_back(distrib(gen));
+  } else if (dataset == "normal") {
+    normal_distribution<double> distrib(max_key / 2, max_key / 16);
+    for (size_t i = 0; i < num_keys; ++i)
+      keys->push_back(to_key(distrib(gen)));
+  } else if (dataset == "lognormal") {
+    // Scaled so that the long tail spans the key domain.
+    lognormal_distribution<double> distrib(/*mean=*/0, /*stddev=*/2);
+    const double scale = max_key / 1e5;
+    for (size_t i = 0; i < num_keys; ++i)
+      keys->push_back(to_key(distrib(gen) * scale));
+  } else if (dataset == "zipf") {
+    // Discrete Pareto with exponent 1.5, i.e., Zipf-like with many
+    // duplicates of small keys.
+    uniform_real_distribution<double> distrib(0, 1);
+    for (size_t i = 0; i < num_keys; ++i)
+      keys->push_back(to_key(floor(pow(1 - distrib(gen), -1 / 0.5))));
+  } else if (dataset == "clustered") {
+    // Time series: bursts of events with small gaps (or duplicate
+    // timestamps) separated by large idle periods.
+    exponential_distribution<double> gap_distrib(1.0 / 4);
+    exponential_distribution<double> idle_distrib(1.0 / (1 << 16));
+    bernoulli_distribution idle(1.0 / 1000);
+    double timestamp = 0;
+    for (size_t i = 0; i < num_keys; ++i) {
+      timestamp += idle(gen) ? idle_distrib(gen) : floor(gap_distrib(gen));
+      keys->push_back(to_key(timestamp));
+    }
+  } else if (dataset == "long_runs") {
+    // Runs of 1 to 2048 duplicates of uniform keys, far longer than the
+    // error bound, which hits resolve with `equal_range`.
+    uniform_int_distribution<KeyType> distrib;
+    uniform_int_distribution<size_t> run_distrib(1, 2048);
+    while (keys->size() < num_keys) {
+      const KeyType key = distrib(gen);
+      const size_t run = min(run_distrib(gen), num_keys - keys->size());
+      keys->insert(keys->end(), run, key);
+    }
+  } else {
+    return false;
+  }
+
+  sort(keys->begin(), keys->end());
+  return true;
+}
+
+// A lookup of the benchmark, one of:
+// - hit: finds the range of an existing key,
+// - miss: finds the range of a (likely) absent key,
+// - scan: sums up the values of the keys in [key, end_key).
+enum class OperationType { kHit, kMiss, kScan };
+
+template <class KeyType>
+struct Operation {
+  OperationType type;
+  KeyType key;
+  KeyType end_key;
+};
+
+// Generates `num_operations` operations, with fractions `miss_ratio` of misses
+// and `scan_ratio` of scans over about `scan_length` keys.
+template <class KeyType>
+vector<Operation<KeyType>> GenerateOperations(const vector<KeyType>& keys,
+                                              size_t num_operations,
+                                              double miss_ratio,
+                                              double scan_ratio,
+                                              size_t scan_length,
+                                              uint64_t seed) {
+  mt19937_64 gen(seed);
+  uniform_int_distribution<size_t> position_distrib(0, keys.size() - 1);
+  uniform_int_distribution<KeyType> key_distrib(keys.front(), keys.back());
+  uniform_real_distribution<double> type_distrib(0, 1);
+  vector<Operation<KeyType>> operations;
+  operations.reserve(num_operations);
+  for (size_t i = 0; i < num_operations; ++i) {
+    const double type = type_distrib(gen);
+    const size_t position = position_distrib(gen);
+    if (type < scan_ratio) {
+      // Start at the first duplicate, so that scans cover at most
+      // `scan_length` keys.
+      const size_t begin_position =
+          lower_bound(keys.begin(), keys.end(), keys[position]) - keys.begin();
+      const size_t end_position =
+          min(begin_position + scan_length, keys.size() - 1);
+      operations.push_back(
+          {OperationType::kScan, keys[position], keys[end_position]});
+    } else if (type < scan_ratio + miss_ratio) {
+      operations.push_back({OperationType::kMiss, key_distrib(gen), 0});
+    } else {
+      operations.push_back({OperationType::kHit, keys[position], 0});
+    }
+  }
+  return operations;
+}
+
+// Returns the sum of the values, i.e., positions, in [begin, end).
+uint64_t SumPositions(uint64_t begin, uint64_t end) {
+  return (begin < end) ? (begin + end - 1) * (end - begin) / 2 : 0;
+}
+
+// Returns the checksum of `operations` from a plain binary search on `keys`.
+template <class KeyType>
+uint64_t ComputeExpectedChecksum(const vector<KeyType>& keys,
+                                 const vector<Operation<KeyType>>& operations) {
+  uint64_t checksum = 0;
+  for (const Operation<KeyType>& operation : operations) {
+    const size_t begin =
+        lower_bound(keys.begin(), keys.end(), operation.key) - keys.begin();
+    if (operation.type == OperationType::kScan) {
+      const size_t end =
+          lower_bound(keys.begin(), keys.end(), operation.end_key) -
+          keys.begin();
+      checksum += SumPositions(begin, end);
+    } else {
+      const size_t end =
+          upper_bound(keys.begin(), keys.end(), operation.key) - keys.begin();
+      checksum += begin + end;
+    }
+  }
+  return checksum;
+}
+
+// Runs `operations` on `map` and returns the checksum.
+template <class Map, class KeyType>
+uint64_t RunOperations(const Map& map,
+                       const vector<Operation<KeyType>>& operations) {
+  uint64_t checksum = 0;
+  for (const Operation<KeyType>& operation : operations) {
+    if (operation.type == OperationType::kScan) {
+      map.range(operation.key, operation.end_key)
+          .ForEach([&](KeyType, uint64_t value) { checksum += value; });
+    } else {
+      const auto range = map.equal_range(operation.key);
+      checksum += (range.first - map.begin()) + (range.second - map.begin());
+    }
+  }
+  return checksum;
+}
+
+struct Result {
+  string dataset;
+  size_t key_bits;
+  size_t num_keys;
+  size_t num_radix_bits;
+  size_t max_error;
+  string storage;
+  size_t num_operations;
+  uint64_t build_ns;
+  size_t size_in_bytes;
+  // ns per operation of each trial.
+  vector<double> trial_ns;
+};
+
+// Returns the `quantile` of the sorted `values`.
+double GetQuantile(const vector<double>& values, double quantile) {
+  return values[static_cast<size_t>(quantile * (values.size() - 1))];
+}
+
+// Builds a `Map` on `elements`, runs the trials of `operations` on it and
+// stores the measurements in `result`.
+template <class Map, class KeyType>
+bool MeasureMap(const vector<pair<KeyType, uint64_t>>& elements,
+                const vector<Operation<KeyType>>& operations,
+                uint64_t expected_checksum, const util::Flags& flags,
+                Result* result) {
+  const auto build_begin = chrono::steady_clock::now();
+  const Map map(elements.begin(), elements.end(), result->num_radix_bits,
+                result->max_error);
+  const auto build_end = chrono::steady_clock::now();
+  result->build_ns =
+      chrono::duration_cast<chrono::nanoseconds>(build_end - build_begin)
+          .count();
+  result->size_in_bytes = map.GetIndexSize();
+
+  const size_t num_warmup_trials = flags.GetInt("warmup_trials", 1);
+  const size_t num_trials = flags.GetInt("trials", 5);
+  for (size_t trial = 0; trial < num_warmup_trials + num_trials; ++trial) {
+    const auto begin = chrono::steady_clock::now();
+    const uint64_t checksum = RunOperations(map, operations);
+    const auto end = chrono::steady_clock::now();
+    if (checksum != expected_checksum) {
+      cerr << "wrong result for " << result->dataset << endl;
+      return false;
+    }
+    if (trial >= num_warmup_trials) {
+      result->trial_ns.push_back(
+          chrono::duration_cast<chrono::nanoseconds>(end - begin).count() /
+          static_cast<double>(operations.size()));
+    }
+  }
+  return true;
+}
+
+template <class KeyType>
+bool RunDataset(const string& dataset, const util::Flags& flags,
+                Result* result) {
+  const size_t num_keys = flags.GetInt("num_keys", 10000000);
+  const uint64_t seed = flags.GetInt("seed", 42);
+  vector<KeyType> keys;
+  if (!GenerateKeys(dataset, num_keys, seed, &keys)) {
+    cerr << "unknown dataset " << dataset << endl;
+    return false;
+  }
+  const vector<pair<KeyType, uint64_t>> elements = util::add_values(keys);
+  const vector<Operation<KeyType>> operations = GenerateOperations(
+      keys, flags.GetInt("num_operations", 1000000),
+      flags.GetDouble("miss_ratio", 0.1), flags.GetDouble("scan_ratio", 0.0),
+      flags.GetInt("scan_length", 100), seed + 1);
+  const uint64_t expected_checksum = ComputeExpectedChecksum(keys, operations);
+
+  result->dataset = dataset;
+  result->key_bits = sizeof(KeyType) * 8;
+  result->num_keys = num_keys;
+  result->num_radix_bits = flags.GetInt("num_radix_bits", 18);
+  result->max_error = flags.GetInt("max_error", 32);
+  result->num_operations = operations.size();
+
+  result->storage = flags.Get("storage", "pairs");
+  if (result->storage == "split") {
+    using Map =
+        rs::MultiMap<KeyType, uint64_t, rs::BinarySearch, rs::SplitStorage>;
+    return MeasureMap<Map>(elements, operations, expected_checksum, flags,
+                           result);
+  }
+  if (result->storage != "pairs") {
+    cerr << "unknown storage " << result->storage << endl;
+    return false;
+  }
+  return MeasureMap<rs::MultiMap<KeyType, uint64_t>>(
+      elements, operations, expected_checksum, flags, result);
+}
+
+void WriteCsv(const vector<Result>& results, ostream& out) {
+  out << "dataset,key_bits,num_keys,num_radix_bits,max_error,storage,"
+         "num_operations,build_ns,size_bytes,trials,min_ns_per_op,"
+         "median_ns_per_op,max_ns_per_op\n";
+  for (Result result : results) {
+    sort(result.trial_ns.begin(), result.trial_ns.end());
+    out << result.dataset << ',' << result.key_bits << ',' << result.num_keys
+        << ',' << result.num_radix_bits << ',' << result.max_error << ','
+        << result.storage << ',' << result.num_operations << ','
+        << result.build_ns << ',' << result.size_in_bytes << ','
+        << result.trial_ns.size() << ',' << result.trial_ns.front() << ','
+        << GetQuantile(result.trial_ns, 0.5) << ','
+        << result.trial_ns.back() << '\n';
+  }
+}
+
+void WriteJson(const vector<Result>& results, ostream& out) {
+  out << "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    Result result = results[i];
+    out << "  {\"dataset\": \"" << result.dataset
+        << "\", \"key_bits\": " << result.key_bits
+        << ", \"num_keys\": " << result.num_keys
+        << ", \"num_radix_bits\": " << result.num_radix_bits
+        << ", \"max_error\": " << result.max_error
+        << ", \"storage\": \"" << result.storage << "\""
+        << ", \"num_operations\": " << result.num_operations
+        << ", \"build_ns\": " << result.build_ns
+        << ", \"size_bytes\": " << result.size_in_bytes
+        << ", \"trial_ns_per_op\": [";
+    for (size_t j = 0; j < result.trial_ns.size(); ++j)
+      out << (j > 0 ? ", " : "") << result.trial_ns[j];
+    sort(result.trial_ns.begin(), result.trial_ns.end());
+    out << "], \"median_ns_per_op\": " << GetQuantile(result.trial_ns, 0.5)
+        << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+  }
+  out << "]\n";
+}
+
+// Splits a comma-separated list.
+vector<string> Split(const string& list) {
+  vector<string> items;
+  stringstream stream(list);
+  string item;
+  while (getline(stream, item, ',')) items.push_back(item);
+  return items;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  // --datasets=<list>: comma-separated subset of the generators (default:
+  //   uniform_dense,uniform_sparse,normal,lognormal,zipf,clustered,
+  //   long_runs).
+  // --key_bits=<list>: 32, 64 or both (default: 32,64).
+  // --num_keys=<n>, --seed=<n>: dataset size and seed (10M, 42).
+  // --num_radix_bits=<n>, --max_error=<n>: model config (18, 32).
+  // --storage=pairs|split: `rs::PairStorage` or `rs::SplitStorage` (pairs).
+  // --num_operations=<n>: operations per trial (1M).
+  // --miss_ratio=<f>, --scan_ratio=<f>, --scan_length=<n>: operation mix,
+  //   the remaining operations are hits (0.1, 0.0, 100).
+  // --warmup_trials=<n>, --trials=<n>: untimed and timed trials (1, 5).
+  // --format=csv|json, --output=<file>: result format and file (csv,
+  //   stdout).
+  const util::Flags flags(argc - 1, argv + 1);
+  string datasets_flag;
+  for (const char* dataset : kDatasets)
+    datasets_flag += (datasets_flag.empty() ? "" : ",") + string(dataset);
+  const vector<string> datasets = Split(flags.Get("datasets", datasets_flag));
+  const vector<string> key_bits = Split(flags.Get("key_bits", "32,64"));
+
+  vector<Result> results;
+  for (const string& dataset : datasets) {
+    for (const string& bits : key_bits) {
+      Result result;
+      const bool ok = (bits == "32")
+                          ? RunDataset<uint32_t>(dataset, flags, &result)
+                          : RunDataset<uint64_t>(dataset, flags, &result);
+      if (!ok) return EXIT_FAILURE;
+      results.push_back(result);
+    }
+  }
+
+  ofstream file;
+  if (flags.Has("output")) file.open(flags.Get("output", ""));
+  ostream& out = flags.Has("output") ? file : cout;
+  if (flags.Get("format", "csv") == "json") {
+    WriteJson(results, out);
+  } else {
+    WriteCsv(results, out);
+  }
+  return 0;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Helpers shared by the benchmarks.
+namespace util {
+
+// Loads values from binary file into vector.
+template <typename T>
+static std::vector<T> load_data(const std::string& filename,
+                                bool print = true) {
+  std::vector<T> data;
+  std::ifstream in(filename, std::ios::binary);
+  if (!in.is_open()) {
+    std::cerr << "unable to open " << filename << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // Read size.
+  uint64_t size;
+  in.read(reinterpret_cast<char*>(&size), sizeof(uint64_t));
+  data.resize(size);
+  // Read values.
+  in.read(reinterpret_cast<char*>(data.data()), size * sizeof(T));
+
+  return data;
+}
+
+// Generates deterministic values for keys.
+template <class KeyType>
+static std::vector<std::pair<KeyType, uint64_t>> add_values(
+    const std::vector<KeyType>& keys) {
+  std::vector<std::pair<KeyType, uint64_t>> result;
+  result.reserve(keys.size());
+
+  for (uint64_t i = 0; i < keys.size(); ++i) {
+    std::pair<KeyType, uint64_t> row;
+    row.first = keys[i];
+    row.second = i;
+
+    result.push_back(row);
+  }
+  return result;
+}
+
+// Command-line flags of the form `--name` or `--name=value`.
+class Flags {
+ public:
+  Flags(int argc, char** argv) {
+    for (int i = 0; i < argc; ++i) {
+      const std::string arg = argv[i];
+      if (arg.compare(0, 2, "--") != 0) {
+        std::cerr << "unknown argument " << arg << std::endl;
+        exit(EXIT_FAILURE);
+      }
+      const size_t pos = arg.find('=');
+      if (pos == std::string::npos) {
+        flags_[arg.substr(2)] = "";
+      } else {
+        flags_[arg.substr(2, pos - 2)] = arg.substr(pos + 1);
+      }
+    }
+  }
+
+  bool Has(const std::string& name) const { return flags_.count(name) > 0; }
+
+  // Returns the value of `--name=value`, or `default_value` if not set.
+  std::string Get(const std::string& name,
+                  const std::string& default_value) const {
+    const auto iter = flags_.find(name);
+    return (iter == flags_.end()) ? default_value : iter->second;
+  }
+  uint64_t GetInt(const std::string& name, uint64_t default_value) const {
+    const auto iter = flags_.find(name);
+    return (iter == flags_.end()) ? default_value
+                                  : std::stoull(iter->second);
+  }
+  double GetDouble(const std::string& name, double default_value) const {
+    const auto iter = flags_.find(name);
+    return (iter == flags_.end()) ? default_value : std::stod(iter->second);
+  }
+
+ private:
+  std::map<std::string, std::string> flags_;
+};
+
+}  // namespace util
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace rs {
+
+constexpr size_t kCacheLineSize = 64;
+constexpr size_t kHugePageSize = size_t{2} << 20;
+
+// Backing of large allocations by 2 MiB pages, which cover a radix table or
+// spline with far fewer TLB entries than 4 KiB pages.
+enum class HugePages {
+  // Normal pages.
+  kNone,
+  // Asks for transparent huge pages with `madvise(MADV_HUGEPAGE)`.
+  kTransparent,
+  // Reserved huge pages with `MAP_HUGETLB`, falls back to `kTransparent` if
+  // none are available.
+  kExplicit,
+};
+
+namespace internal {
+
+// Returns true if an allocation of `size` bytes is mapped by
+// `MapHugePages`. Smaller allocations would waste most of a huge page.
+inline bool UsesHugePages(HugePages huge_pages, size_t size) {
+#ifdef __linux__
+  return huge_pages != HugePages::kNone && size >= kHugePageSize;
+#else
+  (void)huge_pages;
+  (void)size;
+  return false;
+#endif
+}
+
+inline size_t RoundUpToHugePage(size_t size) {
+  return (size + kHugePageSize - 1) / kHugePageSize * kHugePageSize;
+}
+
+#ifdef __linux__
+
+// Maps `size` bytes that start at a huge page boundary, returns nullptr on
+// failure. Falls back to normal pages if the kernel has no huge pages.
+inline void* MapHugePages(HugePages huge_pages, size_t size) {
+  size = RoundUpToHugePage(size);
+  if (huge_pages == HugePages::kExplicit) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr != MAP_FAILED) return ptr;
+  }
+
+  // Map an extra huge page and trim the mapping to a huge page boundary, so
+  // that the kernel can back all of it with huge pages.
+  void* raw = mmap(nullptr, size + kHugePageSize, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) return nullptr;
+  const uintptr_t raw_begin = reinterpret_cast<uintptr_t>(raw);
+  const uintptr_t begin = RoundUpToHugePage(raw_begin);
+  const size_t head = begin - raw_begin;
+  if (head > 0) munmap(raw, head);
+  munmap(reinterpret_cast<void*>(begin + size), kHugePageSize - head);
+  // Keeps normal pages if transparent huge pages are disabled.
+  void* ptr = reinterpret_cast<void*>(begin);
+  madvise(ptr, size, MADV_HUGEPAGE);
+  return ptr;
+}
+
+inline void UnmapHugePages(void* ptr, size_t size) {
+  munmap(ptr, RoundUpToHugePage(size));
+}
+
+#endif
+
+}  // namespace internal
+
+// Asks the kernel to back the whole huge pages within [data, data + size) by
+// huge pages, e.g., for an array that was allocated elsewhere. Best effort,
+// memory that is already in use is collapsed where the kernel supports it.
+inline void AdviseHugePages(const void* data, size_t size) {
+#ifdef __linux__
+  const uintptr_t begin =
+      internal::RoundUpToHugePage(reinterpret_cast<uintptr_t>(data));
+  const uintptr_t end =
+      (reinterpret_cast<uintptr_t>(data) + size) / kHugePageSize *
+      kHugePageSize;
+  if (begin >= end) return;
+  void* ptr = reinterpret_cast<void*>(begin);
+  madvise(ptr, end - begin, MADV_HUGEPAGE);
+#ifdef MADV_COLLAPSE
+  madvise(ptr, end - begin, MADV_COLLAPSE);
+#endif
+#else
+  (void)data;
+  (void)size;
+#endif
+}
+
+// Allocates memory that is aligned to `kAlignment` bytes. Allocations of at
+// least a huge page are backed by huge pages according to `HugePages`, and
+// then start at a huge page boundary.
+template <class T, size_t kAlignment = kCacheLineSize>
+class AlignedAllocator {
+ public:
+  using value_type = T;
+  // Containers keep the huge page mode of their source.
+  using propagate_on_container_copy_assignment = std::true_type;
+  using propagate_on_container_move_assignment = std::true_type;
+  using propagate_on_container_swap = std::true_type;
+
+  template <class U>
+  struct rebind {
+    using other = AlignedAllocator<U, kAlignment>;
+  };
+
+  explicit AlignedAllocator(HugePages huge_pages = HugePages::kNone)
+      : huge_pages_(huge_pages) {}
+  template <class U>
+  AlignedAllocator(const AlignedAllocator<U, kAlignment>& other)
+      : huge_pages_(other.huge_pages()) {}
+
+  T* allocate(size_t n) {
+    const size_t size = n * sizeof(T);
+#ifdef __linux__
+    if (internal::UsesHugePages(huge_pages_, size)) {
+      void* ptr = internal::MapHugePages(huge_pages_, size);
+      if (ptr == nullptr) throw std::bad_alloc();
+      return static_cast<T*>(ptr);
+    }
+#endif
+    void* ptr = nullptr;
+    if (posix_memalign(&ptr, kAlignment, size) != 0) throw std::bad_alloc();
+    return static_cast<T*>(ptr);
+  }
+
+  void deallocate(T* ptr, size_t n) {
+#ifdef __linux__
+    if (internal::UsesHugePages(huge_pages_, n * sizeof(T))) {
+      internal::UnmapHugePages(ptr, n * sizeof(T));
+      return;
+    }
+#endif
+    free(ptr);
+  }
+
+  HugePages huge_pages() const { return huge_pages_; }
+
+  template <class U>
+  bool operator==(const AlignedAllocator<U, kAlignment>& other) const {
+    return huge_pages_ == other.huge_pages();
+  }
+  template <class U>
+  bool operator!=(const AlignedAllocator<U, kAlignment>& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  HugePages huge_pages_;
+};
+
+// A vector whose data starts at a cache line boundary.
+template <class T>
+using AlignedVector = std::vector<T, AlignedAllocator<T>>;
+
+}  // namespace rs
@@ -1,25 +1,43 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <limits>
+#include <vector>
 
 #include "common.h"
 #include "radix_spline.h"
 
 namespace rs {
 
+template <class KeyType>
+class HierarchicalBuilder;
+template <class KeyType>
+class ParallelBuilder;
+template <class KeyType>
+class Tuner;
+
 // Allows building a `RadixSpline` in a single pass over sorted data.
 template <class KeyType>
 class Builder {
  public:
   Builder(KeyType min_key, KeyType max_key, size_t num_radix_bits = 18,
-          size_t max_error = 32)
+          size_t max_error = 32,
+          SplineLayout spline_layout = SplineLayout::kCompact,
+          RadixTableEncoding radix_table_encoding = RadixTableEncoding::kPlain,
+          HugePages huge_pages = HugePages::kNone,
+          ErrorBounds error_bounds = ErrorBounds::kGlobal)
       : min_key_(min_key),
         max_key_(max_key),
         num_radix_bits_(num_radix_bits),
         num_shift_bits_(GetNumShiftBits(max_key - min_key, num_radix_bits)),
         max_error_(max_error),
+        spline_layout_(spline_layout),
+        radix_table_encoding_(radix_table_encoding),
+        huge_pages_(huge_pages),
+        error_bounds_(error_bounds),
+        radix_table_(AlignedAllocator<uint32_t>(huge_pages)),
         curr_num_keys_(0),
         curr_num_distinct_keys_(0),
         prev_key_(min_key),
@@ -40,21 +58,112 @@ class Builder {
     AddKey(key, prev_position_ + 1);
   }
 
+  // Adds the keys of the elements in [first, last), `get_key` returns the key
+  // of an element. Produces the same spline as calling `AddKey` for every key,
+  // but keeps the error corridor in registers and skips duplicates with a
+  // single comparison.
+  template <class Iterator, class GetKey = KeyIdentity>
+  void AddKeys(Iterator first, Iterator last,
+               const GetKey& get_key = GetKey()) {
+    // The first two distinct keys initialize the corridor.
+    for (; first != last && curr_num_distinct_keys_ < 2; ++first)
+      AddKey(get_key(*first));
+    if (first == last) return;
+
+    KeyType prev_key = prev_key_;
+    size_t position = prev_position_;
+    size_t num_distinct_keys = 0;
+    Coord<KeyType> upper_limit = upper_limit_;
+    Coord<KeyType> lower_limit = lower_limit_;
+    Coord<KeyType> prev_point = prev_point_;
+    const bool track_segment_errors =
+        error_bounds_ == ErrorBounds::kPerSegment;
+
+    // `B` in algorithm and the corridor relative to it.
+    Coord<KeyType> spline_last = spline_points_.back();
+    double upper_limit_x_diff = upper_limit.x - spline_last.x;
+    double upper_limit_y_diff = upper_limit.y - spline_last.y;
+    double lower_limit_x_diff = lower_limit.x - spline_last.x;
+    double lower_limit_y_diff = lower_limit.y - spline_last.y;
+
+    for (Iterator iter = first; iter != last; ++iter) {
+      const KeyType key = get_key(*iter);
+      ++position;
+      // No new CDF point if the key didn't change.
+      if (key == prev_key) continue;
+      // Keys need to be monotonically increasing.
+      assert(key > prev_key && key <= max_key_);
+      prev_key = key;
+      ++num_distinct_keys;
+
+      // Same steps as in `PossiblyAddKeyToSpline`.
+      const double pos = position;
+      const double upper_y = pos + max_error_;
+      const double lower_y = (pos < max_error_) ? 0 : pos - max_error_;
+      const double x_diff = key - spline_last.x;
+      const double y_diff = pos - spline_last.y;
+
+      if ((ComputeOrientation(upper_limit_x_diff, upper_limit_y_diff, x_diff,
+                              y_diff) != Orientation::CW) ||
+          (ComputeOrientation(lower_limit_x_diff, lower_limit_y_diff, x_diff,
+                              y_diff) != Orientation::CCW)) {
+        // The corridor is cut, add the previous CDF point to the spline.
+        AddKeyToSpline(prev_point.x, prev_point.y);
+        spline_last = prev_point;
+        upper_limit = {key, upper_y};
+        lower_limit = {key, lower_y};
+        upper_limit_x_diff = upper_limit.x - spline_last.x;
+        upper_limit_y_diff = upper_limit.y - spline_last.y;
+        lower_limit_x_diff = lower_limit.x - spline_last.x;
+        lower_limit_y_diff = lower_limit.y - spline_last.y;
+      } else {
+        // Tighten the limits. The updates are hard to predict, hence use
+        // conditional moves instead of branches.
+        const double upper_y_diff = upper_y - spline_last.y;
+        const bool update_upper =
+            ComputeOrientation(upper_limit_x_diff, upper_limit_y_diff, x_diff,
+                               upper_y_diff) == Orientation::CW;
+        upper_limit.x = update_upper ? key : upper_limit.x;
+        upper_limit.y = update_upper ? upper_y : upper_limit.y;
+        upper_limit_x_diff = update_upper ? x_diff : upper_limit_x_diff;
+        upper_limit_y_diff = update_upper ? upper_y_diff : upper_limit_y_diff;
+
+        const double lower_y_diff = lower_y - spline_last.y;
+        const bool update_lower =
+            ComputeOrientation(lower_limit_x_diff, lower_limit_y_diff, x_diff,
+                               lower_y_diff) == Orientation::CCW;
+        lower_limit.x = update_lower ? key : lower_limit.x;
+        lower_limit.y = update_lower ? lower_y : lower_limit.y;
+        lower_limit_x_diff = update_lower ? x_diff : lower_limit_x_diff;
+        lower_limit_y_diff = update_lower ? lower_y_diff : lower_limit_y_diff;
+      }
+      if (track_segment_errors) AddPointToHulls(key, pos);
+      prev_point = {key, pos};
+    }
+
+    curr_num_keys_ += position - prev_position_;
+    curr_num_distinct_keys_ += num_distinct_keys;
+    prev_key_ = prev_key;
+    prev_position_ = position;
+    upper_limit_ = upper_limit;
+    lower_limit_ = lower_limit;
+    prev_point_ = prev_point;
+  }
+
   // Finalizes the construction and returns a read-only `RadixSpline`.
   RadixSpline<KeyType> Finalize() {
     // Last key needs to be equal to `max_key_`.
     assert(curr_num_keys_ == 0 || prev_key_ == max_key_);
 
-    // Ensure that `prev_key_` (== `max_key_`) is last key on spline.
-    if (curr_num_keys_ > 0 && spline_points_.back().x != prev_key_)
-      AddKeyToSpline(prev_key_, prev_position_);
+    FinalizeSpline();
 
     // Maybe even size the radix based on max key right from the start
     FinalizeRadixTable();
 
     return RadixSpline<KeyType>(
         min_key_, max_key_, curr_num_keys_, num_radix_bits_, num_shift_bits_,
-        max_error_, std::move(radix_table_), std::move(spline_points_));
+        max_error_, RadixTable(std::move(radix_table_), radix_table_encoding_),
+        spline_points_, spline_layout_, huge_pages_, segment_errors_);
   }
 
  private:
@@ -72,6 +181,12 @@ class Builder {
     return 64 - num_radix_bits - clzl;
   }
 
+  // Ensures that `prev_key_` (== `max_key_`) is the last key on the spline.
+  void FinalizeSpline() {
+    if (curr_num_keys_ > 0 && spline_points_.back().x != prev_key_)
+      AddKeyToSpline(prev_key_, prev_position_);
+  }
+
   void AddKey(KeyType key, size_t position) {
     assert(key >= min_key_ && key <= max_key_);
     // Keys need to be monotonically increasing.
@@ -89,6 +204,7 @@ class Builder {
   void AddKeyToSpline(KeyType key, double position) {
     spline_points_.push_back({key, position});
     PossiblyAddKeyToRadixTable(key);
+    if (error_bounds_ == ErrorBounds::kPerSegment) FinishSegment();
   }
 
   enum Orientation { Collinear, CW, CCW };
@@ -104,6 +220,68 @@ class Builder {
     return Orientation::Collinear;
   };
 
+  // Adds a CDF point to the convex hulls of the points of the current
+  // segment. The largest errors of a segment are at vertices of its hulls,
+  // which are usually far fewer than its points. Points are added in the
+  // order of their keys (Andrew's monotone chain).
+  void AddPointToHulls(KeyType key, double position) {
+    const Coord<KeyType> point = {key, position};
+    // The upper hull only turns clockwise, the lower one counterclockwise.
+    while (upper_hull_.size() >= 2 &&
+           ComputeHullOrientation(upper_hull_[upper_hull_.size() - 2],
+                                  upper_hull_.back(), point) != Orientation::CW)
+      upper_hull_.pop_back();
+    upper_hull_.push_back(point);
+    while (lower_hull_.size() >= 2 &&
+           ComputeHullOrientation(lower_hull_[lower_hull_.size() - 2],
+                                  lower_hull_.back(),
+                                  point) != Orientation::CCW)
+      lower_hull_.pop_back();
+    lower_hull_.push_back(point);
+  }
+
+  static Orientation ComputeHullOrientation(const Coord<KeyType>& origin,
+                                            const Coord<KeyType>& a,
+                                            const Coord<KeyType>& b) {
+    return ComputeOrientation(a.x - origin.x, a.y - origin.y, b.x - origin.x,
+                              b.y - origin.y);
+  }
+
+  // Stores the largest errors below and above the estimates of the segment
+  // that ends at the last spline point, and starts the hulls of the next
+  // segment at that point.
+  void FinishSegment() {
+    const size_t index = spline_points_.size() - 1;
+    double below = 0;
+    double above = 0;
+    if (index > 0) {
+      // Same interpolation as `RadixSplineView::Interpolate`.
+      const Coord<KeyType>& down = spline_points_[index - 1];
+      const double x_diff = spline_points_[index].x - down.x;
+      const double slope = (spline_points_[index].y - down.y) / x_diff;
+      const auto interpolate = [&](const Coord<KeyType>& point) {
+        return std::fma(static_cast<double>(point.x - down.x), slope, down.y);
+      };
+      for (const Coord<KeyType>& point : lower_hull_)
+        below = std::max(below, interpolate(point) - point.y);
+      for (const Coord<KeyType>& point : upper_hull_)
+        above = std::max(above, point.y - interpolate(point));
+    }
+    segment_errors_.push_back(QuantizeSegmentError(below));
+    segment_errors_.push_back(QuantizeSegmentError(above));
+    upper_hull_.assign(1, spline_points_.back());
+    lower_hull_.assign(1, spline_points_.back());
+  }
+
+  // Rounds `error` up to a multiple of `GetSegmentErrorUnit`. Errors beyond
+  // `max_error_`, e.g., of the largest key, whose spline point is at its last
+  // duplicate, are capped. Lookups of such keys fall back to a search beyond
+  // the bound, like with the global bound.
+  uint8_t QuantizeSegmentError(double error) const {
+    const double unit = GetSegmentErrorUnit(max_error_);
+    return std::ceil(std::min<double>(error, max_error_) / unit);
+  }
+
   void SetUpperLimit(KeyType key, double position) {
     upper_limit_ = {key, position};
   }
@@ -139,6 +317,8 @@ class Builder {
       // point.
       SetUpperLimit(key, position + max_error_);
       SetLowerLimit(key, (position < max_error_) ? 0 : position - max_error_);
+      if (error_bounds_ == ErrorBounds::kPerSegment)
+        AddPointToHulls(key, position);
       RememberPreviousCDFPoint(key, position);
       return;
     }
@@ -195,6 +375,8 @@ class Builder {
       }
     }
 
+    if (error_bounds_ == ErrorBounds::kPerSegment)
+      AddPointToHulls(key, position);
     RememberPreviousCDFPoint(key, position);
   }
 
@@ -220,9 +402,20 @@ class Builder {
   const size_t num_radix_bits_;
   const size_t num_shift_bits_;
   const size_t max_error_;
+  const SplineLayout spline_layout_;
+  const RadixTableEncoding radix_table_encoding_;
+  const HugePages huge_pages_;
+  const ErrorBounds error_bounds_;
 
-  std::vector<uint32_t> radix_table_;
+  AlignedVector<uint32_t> radix_table_;
   std::vector<Coord<KeyType>> spline_points_;
+  // Two bytes per spline point, see `FinishSegment`. Empty unless the error
+  // bounds are `ErrorBounds::kPerSegment`.
+  std::vector<uint8_t> segment_errors_;
+  // Convex hulls of the CDF points of the current segment, see
+  // `AddPointToHulls`.
+  std::vector<Coord<KeyType>> upper_hull_;
+  std::vector<Coord<KeyType>> lower_hull_;
 
   size_t curr_num_keys_;
   size_t curr_num_distinct_keys_;
@@ -236,6 +429,13 @@ class Builder {
 
   // Previous CDF point.
   Coord<KeyType> prev_point_;
+
+  template <typename>
+  friend class HierarchicalBuilder;
+  template <typename>
+  friend class ParallelBuilder;
+  template <typename>
+  friend class Tuner;
 };
 
 }  // namespace rs
\ No newline at end of file
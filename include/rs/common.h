@@ -12,6 +12,42 @@ struct Coord {
   double y;
 };
 
+// Memory layout of the spline points. Keys and positions are always stored in
+// separate arrays.
+enum class SplineLayout {
+  // Computes the slope of a segment on each lookup.
+  kCompact,
+  // Additionally stores the slope of each segment, so that interpolation is a
+  // single FMA. Costs 8 bytes per spline point.
+  kPrecomputedSlopes,
+};
+
+// Encoding of the radix table.
+enum class RadixTableEncoding {
+  // One `uint32_t` per entry.
+  kPlain,
+  // One `uint32_t` base per block of entries plus an 8- or 16-bit delta per
+  // entry. Falls back to `kPlain` if the deltas don't fit into 16 bits.
+  kCompressed,
+};
+
+// Width of the search bounds around an estimated position.
+enum class ErrorBounds {
+  // `max_error` below and above every estimate.
+  kGlobal,
+  // Additionally stores the largest error below and above the estimates of
+  // each spline segment, in one byte each. Segments that fit the data more
+  // tightly than `max_error` then get narrower, asymmetric bounds.
+  kPerSegment,
+};
+
+// Per-segment errors are stored in multiples of this unit, so that errors up
+// to `max_error` fit into a byte.
+inline size_t GetSegmentErrorUnit(size_t max_error) {
+  return (max_error <= UINT8_MAX) ? 1
+                                  : (max_error + UINT8_MAX - 1) / UINT8_MAX;
+}
+
 struct SearchBound {
   size_t begin;
   size_t end;  // Exclusive.
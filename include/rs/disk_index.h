@@ -0,0 +1,438 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "allocator.h"
+#include "builder.h"
+#include "radix_spline.h"
+
+namespace rs {
+
+// I/O statistics of a `DiskIndex`.
+struct DiskStats {
+  // Number of `pread` calls.
+  size_t num_reads = 0;
+  size_t num_bytes_read = 0;
+  // Number of pages served by the page cache.
+  size_t num_cache_hits = 0;
+};
+
+namespace internal {
+
+// Caches the least recently used fixed-size pages of a file.
+class PageCache {
+ public:
+  PageCache(size_t num_pages = 0, size_t page_size = 0)
+      : page_size_(page_size),
+        pages_(num_pages),
+        buffer_(num_pages * page_size) {}
+
+  // Returns the cached copy of `page`, or nullptr if it isn't cached.
+  const char* Get(uint64_t page) {
+    const auto iter = slots_.find(page);
+    if (iter == slots_.end()) return nullptr;
+    lru_.splice(lru_.begin(), lru_, iter->second);
+    return GetSlot(*iter->second);
+  }
+
+  // Caches a copy of `page` at `data`, evicts the least recently used page if
+  // the cache is full.
+  void Put(uint64_t page, const char* data) {
+    if (pages_.empty() || slots_.count(page) > 0) return;
+    size_t slot;
+    if (slots_.size() < pages_.size()) {
+      slot = slots_.size();
+      lru_.push_front(slot);
+    } else {
+      slot = lru_.back();
+      slots_.erase(pages_[slot]);
+      lru_.splice(lru_.begin(), lru_, std::prev(lru_.end()));
+    }
+    pages_[slot] = page;
+    slots_[page] = lru_.begin();
+    std::memcpy(GetSlot(slot), data, page_size_);
+  }
+
+  size_t capacity() const { return pages_.size(); }
+
+ private:
+  char* GetSlot(size_t slot) { return buffer_.data() + slot * page_size_; }
+
+  size_t page_size_;
+  // Slots, the most recently used first.
+  std::list<size_t> lru_;
+  std::unordered_map<uint64_t, std::list<size_t>::iterator> slots_;
+  // The page in each slot.
+  std::vector<uint64_t> pages_;
+  std::vector<char> buffer_;
+};
+
+}  // namespace internal
+
+// Serves lookups on sorted keys in a file with a `RadixSpline` in memory. Each
+// lookup reads the pages of its search bound, i.e., about `2 * max_error + 2`
+// keys, with a single `pread`. The file holds a `uint64_t` count followed by
+// the keys, the format of the SOSD benchmark. Not thread-safe, lookups share
+// a buffer and the page cache.
+template <class KeyType>
+class DiskIndex {
+ public:
+  // Unit of all reads. Offsets and sizes are multiples of it, as needed for
+  // direct I/O.
+  static constexpr size_t kPageSize = 4096;
+  // Largest read of coalesced pages in `LowerBoundBatch`.
+  static constexpr size_t kMaxReadPages = 256;
+
+  DiskIndex() = default;
+  ~DiskIndex() { Close(); }
+
+  DiskIndex(const DiskIndex&) = delete;
+  DiskIndex& operator=(const DiskIndex&) = delete;
+
+  // Opens the keys in the file at `path` and builds a spline on them in a
+  // single sequential scan. Keeps up to `num_cached_pages` pages in a page
+  // cache. With `direct_io`, reads bypass the operating system's page cache
+  // (`O_DIRECT`). Returns false if the file cannot be read, is truncated, or
+  // is not sorted.
+  bool Open(const std::string& path, size_t num_radix_bits = 18,
+            size_t max_error = 32, size_t num_cached_pages = 0,
+            bool direct_io = false);
+
+  // Closes the file.
+  void Close() {
+    if (fd_ >= 0) close(fd_);
+    fd_ = -1;
+    num_keys_ = 0;
+  }
+
+  // Returns the number of keys in the file.
+  size_t size() const { return num_keys_; }
+
+  const RadixSpline<KeyType>& spline() const { return spline_; }
+
+  // Statistics since `Open` or the last `ResetStats`.
+  const DiskStats& stats() const { return stats_; }
+  void ResetStats() { stats_ = DiskStats(); }
+
+  // Stores the position of the first key that is not smaller than `key` in
+  // `position`, or `size()` if there is none. Returns false on read errors.
+  bool LowerBound(KeyType key, size_t* position);
+
+  // Batched `LowerBound`, stores the result for `keys[i]` in `positions[i]`.
+  // Sorts the search bounds by offset and reads overlapping and adjacent
+  // pages with a single `pread`.
+  bool LowerBoundBatch(const KeyType* keys, size_t num_keys,
+                       size_t* positions);
+
+ private:
+  using PageBuffer = std::vector<char, AlignedAllocator<char, kPageSize>>;
+
+  // Size of the count that precedes the keys.
+  static constexpr size_t kHeaderSize = sizeof(uint64_t);
+  // Size of the reads of the scan in `Open`.
+  static constexpr size_t kScanSize = 1024 * kPageSize;
+
+  // Returns the offset of the key at `position` in the file.
+  static uint64_t GetOffset(size_t position) {
+    return kHeaderSize + position * sizeof(KeyType);
+  }
+
+  // Returns the first page and the end of the pages that hold the keys in
+  // [begin, end).
+  static std::pair<uint64_t, uint64_t> GetPages(size_t begin, size_t end) {
+    return {GetOffset(begin) / kPageSize,
+            (GetOffset(end) + kPageSize - 1) / kPageSize};
+  }
+
+  // Reads `size` bytes at `offset` into `out` with a single `pread`, unless
+  // the kernel reads partially. Stops at the end of the file.
+  bool Read(uint64_t offset, size_t size, char* out) {
+    ++stats_.num_reads;
+    while (size > 0) {
+      const ssize_t num_read = pread(fd_, out, size, offset);
+      if (num_read < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      if (num_read == 0) return true;
+      stats_.num_bytes_read += num_read;
+      offset += num_read;
+      out += num_read;
+      size -= num_read;
+    }
+    return true;
+  }
+
+  // Reads the pages [first_page, end_page) into `out`. Cached pages are
+  // copied, each run of uncached pages is read with a single `pread`.
+  bool ReadPages(uint64_t first_page, uint64_t end_page, char* out) {
+    if (cache_.capacity() == 0) {
+      return Read(first_page * kPageSize, (end_page - first_page) * kPageSize,
+                  out);
+    }
+    for (uint64_t page = first_page; page < end_page;) {
+      char* page_out = out + (page - first_page) * kPageSize;
+      if (const char* cached = cache_.Get(page)) {
+        std::memcpy(page_out, cached, kPageSize);
+        ++stats_.num_cache_hits;
+        ++page;
+        continue;
+      }
+      uint64_t run_end = page + 1;
+      while (run_end < end_page && cache_.Get(run_end) == nullptr) ++run_end;
+      if (!Read(page * kPageSize, (run_end - page) * kPageSize, page_out))
+        return false;
+      for (; page < run_end; ++page)
+        cache_.Put(page, out + (page - first_page) * kPageSize);
+    }
+    return true;
+  }
+
+  // Reads the keys in [begin, end) into `buffer_`. Returns a pointer to the
+  // key at `begin`, or nullptr on read errors.
+  const KeyType* ReadKeys(size_t begin, size_t end) {
+    const std::pair<uint64_t, uint64_t> pages = GetPages(begin, end);
+    buffer_.resize((pages.second - pages.first) * kPageSize);
+    if (!ReadPages(pages.first, pages.second, buffer_.data())) return nullptr;
+    return reinterpret_cast<const KeyType*>(
+        buffer_.data() + (GetOffset(begin) - pages.first * kPageSize));
+  }
+
+  // Like `LowerBound`, but for the keys in [begin, end) at `keys`. Returns
+  // false if the lower bound may be outside of [begin, end), see
+  // `RadixSplineView::LowerBoundWithin`.
+  bool LowerBoundWithin(const KeyType* keys, SearchBound bound, KeyType key,
+                        size_t* position) const {
+    const KeyType* end = keys + (bound.end - bound.begin);
+    *position = bound.begin + (std::lower_bound(keys, end, key) - keys);
+    return !((*position == bound.end && bound.end < num_keys_) ||
+             (*position == bound.begin && bound.begin > 0));
+  }
+
+  // Finds the lower bound of `key` outside of `bound`, starting from
+  // `position`, the result within `bound`. Reads exponentially growing ranges
+  // away from `bound`. Only needed for keys that are not in the data, e.g.,
+  // ones that follow a long run of duplicates.
+  bool Gallop(SearchBound bound, KeyType key, size_t* position);
+
+  int fd_ = -1;
+  size_t num_keys_ = 0;
+  RadixSpline<KeyType> spline_;
+  internal::PageCache cache_;
+  PageBuffer buffer_;
+  DiskStats stats_;
+};
+
+template <class KeyType>
+constexpr size_t DiskIndex<KeyType>::kPageSize;
+template <class KeyType>
+constexpr size_t DiskIndex<KeyType>::kMaxReadPages;
+template <class KeyType>
+constexpr size_t DiskIndex<KeyType>::kHeaderSize;
+template <class KeyType>
+constexpr size_t DiskIndex<KeyType>::kScanSize;
+
+template <class KeyType>
+bool DiskIndex<KeyType>::Open(const std::string& path, size_t num_radix_bits,
+                              size_t max_error, size_t num_cached_pages,
+                              bool direct_io) {
+  Close();
+  int flags = O_RDONLY;
+#ifdef O_DIRECT
+  if (direct_io) flags |= O_DIRECT;
+#else
+  (void)direct_io;
+#endif
+  fd_ = open(path.c_str(), flags);
+  if (fd_ < 0) return false;
+
+  // The scan reads whole chunks, which start at a page boundary and hence
+  // at a key boundary.
+  PageBuffer chunk(kScanSize);
+  struct stat stats;
+  uint64_t num_keys = 0;
+  if (fstat(fd_, &stats) != 0 || !Read(0, kPageSize, chunk.data()) ||
+      static_cast<uint64_t>(stats.st_size) < kHeaderSize) {
+    Close();
+    return false;
+  }
+  std::memcpy(&num_keys, chunk.data(), sizeof(num_keys));
+  if ((static_cast<uint64_t>(stats.st_size) - kHeaderSize) / sizeof(KeyType) <
+      num_keys) {
+    Close();
+    return false;
+  }
+
+  if (num_keys == 0) {
+    Builder<KeyType> rsb(std::numeric_limits<KeyType>::min(),
+                         std::numeric_limits<KeyType>::max(), num_radix_bits,
+                         max_error);
+    spline_ = rsb.Finalize();
+  } else {
+    KeyType min_key;
+    KeyType max_key;
+    std::memcpy(&min_key, chunk.data() + kHeaderSize, sizeof(KeyType));
+    const uint64_t max_offset = GetOffset(num_keys - 1);
+    if (!Read(max_offset / kPageSize * kPageSize, kPageSize, chunk.data())) {
+      Close();
+      return false;
+    }
+    std::memcpy(&max_key, chunk.data() + max_offset % kPageSize,
+                sizeof(KeyType));
+
+    Builder<KeyType> rsb(min_key, max_key, num_radix_bits, max_error);
+    const uint64_t end_offset = GetOffset(num_keys);
+    KeyType prev_key = min_key;
+    for (uint64_t offset = 0; offset < end_offset; offset += kScanSize) {
+      if (!Read(offset, kScanSize, chunk.data())) {
+        Close();
+        return false;
+      }
+      const uint64_t begin = std::max(offset, uint64_t{kHeaderSize});
+      const uint64_t end = std::min(offset + kScanSize, end_offset);
+      const KeyType* keys =
+          reinterpret_cast<const KeyType*>(chunk.data() + (begin - offset));
+      const size_t count = (end - begin) / sizeof(KeyType);
+      if (keys[0] < prev_key || !std::is_sorted(keys, keys + count)) {
+        Close();
+        return false;
+      }
+      prev_key = keys[count - 1];
+      rsb.AddKeys(keys, keys + count);
+    }
+    spline_ = rsb.Finalize();
+  }
+
+  num_keys_ = num_keys;
+  cache_ = internal::PageCache(num_cached_pages, kPageSize);
+  stats_ = DiskStats();
+  return true;
+}
+
+template <class KeyType>
+bool DiskIndex<KeyType>::LowerBound(KeyType key, size_t* position) {
+  if (num_keys_ == 0) {
+    *position = 0;
+    return true;
+  }
+  const SearchBound bound = spline_.GetSearchBound(key);
+  const KeyType* keys = ReadKeys(bound.begin, bound.end);
+  if (keys == nullptr) return false;
+  if (LowerBoundWithin(keys, bound, key, position)) return true;
+  return Gallop(bound, key, position);
+}
+
+template <class KeyType>
+bool DiskIndex<KeyType>::LowerBoundBatch(const KeyType* keys, size_t num_keys,
+                                         size_t* positions) {
+  if (num_keys_ == 0) {
+    std::fill(positions, positions + num_keys, 0);
+    return true;
+  }
+
+  struct Request {
+    size_t index;
+    SearchBound bound;
+    std::pair<uint64_t, uint64_t> pages;
+  };
+  std::vector<Request> requests(num_keys);
+  for (size_t i = 0; i < num_keys; ++i) {
+    const SearchBound bound = spline_.GetSearchBound(keys[i]);
+    requests[i] = {i, bound, GetPages(bound.begin, bound.end)};
+  }
+  std::sort(requests.begin(), requests.end(),
+            [](const Request& lhs, const Request& rhs) {
+              return lhs.pages.first < rhs.pages.first;
+            });
+
+  // Lookups whose lower bound may be outside of their search bound, resolved
+  // once all runs are read.
+  std::vector<const Request*> outside;
+  for (size_t run_begin = 0; run_begin < num_keys;) {
+    const uint64_t first_page = requests[run_begin].pages.first;
+    uint64_t end_page = requests[run_begin].pages.second;
+    size_t run_end = run_begin + 1;
+    for (; run_end < num_keys; ++run_end) {
+      const std::pair<uint64_t, uint64_t>& pages = requests[run_end].pages;
+      if (pages.first > end_page ||
+          std::max(end_page, pages.second) - first_page > kMaxReadPages)
+        break;
+      end_page = std::max(end_page, pages.second);
+    }
+
+    buffer_.resize((end_page - first_page) * kPageSize);
+    if (!ReadPages(first_page, end_page, buffer_.data())) return false;
+    for (size_t i = run_begin; i < run_end; ++i) {
+      const Request& request = requests[i];
+      const KeyType* bound_keys = reinterpret_cast<const KeyType*>(
+          buffer_.data() +
+          (GetOffset(request.bound.begin) - first_page * kPageSize));
+      if (!LowerBoundWithin(bound_keys, request.bound, keys[request.index],
+                            &positions[request.index]))
+        outside.push_back(&request);
+    }
+    run_begin = run_end;
+  }
+
+  for (const Request* request : outside) {
+    if (!Gallop(request->bound, keys[request->index],
+                &positions[request->index]))
+      return false;
+  }
+  return true;
+}
+
+template <class KeyType>
+bool DiskIndex<KeyType>::Gallop(SearchBound bound, KeyType key,
+                                size_t* position) {
+  size_t step =
+      std::max<size_t>(bound.end - bound.begin, kPageSize / sizeof(KeyType));
+  if (*position == bound.end && bound.end < num_keys_) {
+    // All keys before `from` are smaller than `key`.
+    for (size_t from = bound.end; from < num_keys_; step *= 2) {
+      const size_t to = std::min(num_keys_, from + step);
+      const KeyType* keys = ReadKeys(from, to);
+      if (keys == nullptr) return false;
+      const size_t index = std::lower_bound(keys, keys + (to - from), key) -
+                           keys;
+      if (from + index < to) {
+        *position = from + index;
+        return true;
+      }
+      from = to;
+    }
+    *position = num_keys_;
+    return true;
+  }
+
+  // All keys from `to` on are not smaller than `key`.
+  for (size_t to = bound.begin; to > 0; step *= 2) {
+    const size_t from = to - std::min(to, step);
+    const KeyType* keys = ReadKeys(from, to);
+    if (keys == nullptr) return false;
+    const size_t index = std::lower_bound(keys, keys + (to - from), key) - keys;
+    if (index > 0) {
+      *position = from + index;
+      return true;
+    }
+    to = from;
+  }
+  *position = 0;
+  return true;
+}
+
+}  // namespace rs
@@ -0,0 +1,166 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace rs {
+
+// Every section of the aligned format starts at a multiple of this many bytes
+// from the beginning of the model.
+constexpr size_t kFormatAlignment = 64;
+
+// Header of the aligned format that `RadixSplineView` reads in place. The
+// sections listed in `FormatSection` follow the header in that order. All
+// values are stored in the byte order of the writing machine, which
+// `endianness_marker` records.
+struct FormatHeader {
+  static constexpr uint64_t kMagic = 0x454e494c50535852;  // "RXSPLINE"
+  // Version 2 added the checksum, version 3 `error_bounds`. Models without
+  // per-segment errors are the same in both.
+  static constexpr uint32_t kVersion = 3;
+  // Oldest version that can still be read.
+  static constexpr uint32_t kMinVersion = 2;
+  static constexpr uint32_t kEndiannessMarker = 0x01020304;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t endianness_marker;
+  // `sizeof(KeyType)`.
+  uint32_t key_size;
+  // `SplineLayout`.
+  uint32_t spline_layout;
+  // Size of a radix table delta in bytes, 0 for the plain encoding.
+  uint32_t radix_table_delta_width;
+  // `ErrorBounds`, always `kGlobal` (0) in version 2.
+  uint32_t error_bounds;
+  uint64_t min_key;
+  uint64_t max_key;
+  uint64_t num_keys;
+  uint64_t num_radix_bits;
+  uint64_t num_shift_bits;
+  uint64_t max_error;
+  uint64_t num_radix_table_entries;
+  uint64_t num_spline_points;
+  // `Hash64` over the header (with a zero checksum) and all sections,
+  // excluding the padding.
+  uint64_t checksum;
+};
+
+// The sections of the aligned format in the order in which they are stored.
+enum FormatSection {
+  // Entries (plain) or bases (compressed), `uint32_t`.
+  kRadixTableEntries,
+  // Deltas, `uint8_t`, empty for the plain encoding.
+  kRadixTableDeltas,
+  // `KeyType`.
+  kSplineKeys,
+  // `double`.
+  kSplinePositions,
+  // `double`, empty unless the layout is `SplineLayout::kPrecomputedSlopes`.
+  kSplineSlopes,
+  // `uint8_t`, the errors below and above the estimates of each segment in
+  // multiples of `GetSegmentErrorUnit`. Empty unless the error bounds are
+  // `ErrorBounds::kPerSegment`.
+  kSegmentErrors,
+  kNumFormatSections,
+};
+
+// Sizes in bytes of the sections of a model.
+using FormatSectionSizes = std::array<size_t, kNumFormatSections>;
+
+// Byte offsets of the sections of a model in the aligned format.
+struct FormatLayout {
+  std::array<size_t, kNumFormatSections> offsets;
+  // Size of the entire model including the padding of the last section.
+  size_t total_size;
+
+  static FormatLayout Compute(const FormatSectionSizes& section_sizes) {
+    FormatLayout layout;
+    size_t offset = Align(sizeof(FormatHeader));
+    for (size_t i = 0; i < kNumFormatSections; ++i) {
+      layout.offsets[i] = offset;
+      offset = Align(offset + section_sizes[i]);
+    }
+    layout.total_size = offset;
+    return layout;
+  }
+
+ private:
+  static size_t Align(size_t offset) {
+    return (offset + kFormatAlignment - 1) / kFormatAlignment *
+           kFormatAlignment;
+  }
+};
+
+// A fast, non-cryptographic 64-bit hash (xxHash64) to detect corrupted and
+// truncated models. Processes 32 bytes per iteration.
+inline uint64_t Hash64(const void* bytes, size_t size, uint64_t seed) {
+  constexpr uint64_t kPrime1 = 0x9e3779b185ebca87;
+  constexpr uint64_t kPrime2 = 0xc2b2ae3d27d4eb4f;
+  constexpr uint64_t kPrime3 = 0x165667b19e3779f9;
+  constexpr uint64_t kPrime4 = 0x85ebca77c2b2ae63;
+  constexpr uint64_t kPrime5 = 0x27d4eb2f165667c5;
+  const auto rotl = [](uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+  };
+  const auto round = [&](uint64_t acc, uint64_t input) {
+    return rotl(acc + input * kPrime2, 31) * kPrime1;
+  };
+  const auto merge = [&](uint64_t acc, uint64_t value) {
+    return (acc ^ round(0, value)) * kPrime1 + kPrime4;
+  };
+  const auto read64 = [](const char* p) {
+    uint64_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  };
+  const auto read32 = [](const char* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+  };
+
+  const char* p = static_cast<const char*>(bytes);
+  const char* const end = p + size;
+  uint64_t hash;
+  if (size >= 32) {
+    uint64_t v1 = seed + kPrime1 + kPrime2;
+    uint64_t v2 = seed + kPrime2;
+    uint64_t v3 = seed;
+    uint64_t v4 = seed - kPrime1;
+    for (; p + 32 <= end; p += 32) {
+      v1 = round(v1, read64(p));
+      v2 = round(v2, read64(p + 8));
+      v3 = round(v3, read64(p + 16));
+      v4 = round(v4, read64(p + 24));
+    }
+    hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+    hash = merge(hash, v1);
+    hash = merge(hash, v2);
+    hash = merge(hash, v3);
+    hash = merge(hash, v4);
+  } else {
+    hash = seed + kPrime5;
+  }
+  hash += size;
+
+  for (; p + 8 <= end; p += 8)
+    hash = rotl(hash ^ round(0, read64(p)), 27) * kPrime1 + kPrime4;
+  if (p + 4 <= end) {
+    hash = rotl(hash ^ (read32(p) * kPrime1), 23) * kPrime2 + kPrime3;
+    p += 4;
+  }
+  for (; p < end; ++p)
+    hash = rotl(hash ^ (static_cast<uint8_t>(*p) * kPrime5), 11) * kPrime1;
+
+  hash ^= hash >> 33;
+  hash *= kPrime2;
+  hash ^= hash >> 29;
+  hash *= kPrime3;
+  hash ^= hash >> 32;
+  return hash;
+}
+
+}  // namespace rs
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "builder.h"
+#include "hierarchical_radix_spline.h"
+
+namespace rs {
+
+// Allows building a `HierarchicalRadixSpline` in a single pass over sorted
+// data. Fits the same spline as `Builder` and refines every radix table bucket
+// with more than `max_bucket_size` spline points into a child node.
+// Only supports `ErrorBounds::kGlobal`, searches always use `max_error`.
+template <class KeyType>
+class HierarchicalBuilder {
+ public:
+  HierarchicalBuilder(KeyType min_key, KeyType max_key,
+                      size_t num_radix_bits = 18, size_t max_error = 32,
+                      size_t max_bucket_size = 32)
+      : builder_(min_key, max_key, num_radix_bits, max_error),
+        max_bucket_size_(max_bucket_size) {}
+
+  // Adds a key. Assumes that keys are stored in a dense array.
+  void AddKey(KeyType key) { builder_.AddKey(key); }
+
+  // Finalizes the construction and returns a read-only
+  // `HierarchicalRadixSpline`.
+  HierarchicalRadixSpline<KeyType> Finalize() {
+    // Last key needs to be equal to `max_key_`.
+    assert(builder_.curr_num_keys_ == 0 ||
+           builder_.prev_key_ == builder_.max_key_);
+    builder_.FinalizeSpline();
+    builder_.FinalizeRadixTable();
+
+    // The flat radix table becomes the root node.
+    using Node = typename HierarchicalRadixSpline<KeyType>::Node;
+    std::vector<Node> nodes = {{builder_.min_key_,
+                                static_cast<uint32_t>(builder_.num_shift_bits_),
+                                /*offset=*/0, /*begin=*/0}};
+    AlignedVector<uint32_t> entries = std::move(builder_.radix_table_);
+    uint32_t num_entries = entries.size();
+
+    // Refine dense buckets breadth-first.
+    std::deque<std::pair<size_t, uint32_t>> queue = {{0, num_entries}};
+    while (!queue.empty()) {
+      const size_t node_index = queue.front().first;
+      num_entries = queue.front().second;
+      queue.pop_front();
+      // `nodes` may grow, copy the node.
+      const Node node = nodes[node_index];
+      if (node.num_shift_bits == 0) continue;
+
+      for (uint32_t bucket = 0; bucket + 1 < num_entries; ++bucket) {
+        const uint32_t begin = entries[node.offset + bucket];
+        const uint32_t end = entries[node.offset + bucket + 1];
+        if (end - begin <= max_bucket_size_) continue;
+
+        // Use about one bucket per spline point.
+        const uint32_t num_child_radix_bits = std::min<uint32_t>(
+            node.num_shift_bits, 64 - __builtin_clzl(end - begin));
+        const Node child = {
+            static_cast<KeyType>(node.base +
+                                 (static_cast<KeyType>(bucket)
+                                  << node.num_shift_bits)),
+            node.num_shift_bits - num_child_radix_bits,
+            static_cast<uint32_t>(entries.size()), begin};
+        const uint32_t num_child_entries = (1u << num_child_radix_bits) + 1;
+        AppendEntries(child, begin, end, num_child_entries, &entries);
+
+        entries[node.offset + bucket] =
+            HierarchicalRadixSpline<KeyType>::kChildFlag | nodes.size();
+        queue.push_back({nodes.size(), num_child_entries});
+        nodes.push_back(child);
+      }
+    }
+
+    return HierarchicalRadixSpline<KeyType>(
+        builder_.min_key_, builder_.max_key_, builder_.curr_num_keys_,
+        builder_.max_error_, std::move(nodes), std::move(entries),
+        builder_.spline_points_);
+  }
+
+ private:
+  // Appends the entries of the node `child` over the spline points in
+  // [begin, end) to `entries`.
+  void AppendEntries(
+      const typename HierarchicalRadixSpline<KeyType>::Node& child,
+      uint32_t begin, uint32_t end, uint32_t num_entries,
+      AlignedVector<uint32_t>* entries) const {
+    const auto& spline_points = builder_.spline_points_;
+    uint32_t prefix = 0;
+    for (uint32_t index = begin; index < end; ++index) {
+      const KeyType curr_prefix =
+          (spline_points[index].x - child.base) >> child.num_shift_bits;
+      for (; prefix <= curr_prefix; ++prefix) entries->push_back(index);
+    }
+    for (; prefix < num_entries; ++prefix) entries->push_back(end);
+  }
+
+  Builder<KeyType> builder_;
+  const size_t max_bucket_size_;
+};
+
+}  // namespace rs
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "allocator.h"
+#include "common.h"
+#include "simd_search.h"
+
+namespace rs {
+
+// A `RadixSpline` whose radix table is refined into a tree where spline points
+// are crowded, so that skewed key distributions also end up with a small
+// number of candidate segments per lookup.
+//
+// Every node is a radix table over the keys in [base, base + (size <<
+// shift)): entry `i` holds the index of the first spline point with a key of
+// at least `base + (i << shift)`, followed by an end entry. An entry with
+// `kChildFlag` set instead refers to a child node that refines the bucket.
+// The root node corresponds to the flat radix table of `RadixSpline`.
+template <class KeyType>
+class HierarchicalRadixSpline {
+ public:
+  // A radix table in the tree.
+  struct Node {
+    // Smallest key of the node.
+    KeyType base;
+    uint32_t num_shift_bits;
+    // Index of the first entry of the node.
+    uint32_t offset;
+    // Index of the first spline point with a key of at least `base`, i.e., the
+    // entry that the child flag replaces in the parent node.
+    uint32_t begin;
+  };
+
+  static constexpr uint32_t kChildFlag = 1u << 31;
+
+  HierarchicalRadixSpline() = default;
+
+  HierarchicalRadixSpline(KeyType min_key, KeyType max_key, size_t num_keys,
+                          size_t max_error, std::vector<Node> nodes,
+                          AlignedVector<uint32_t> entries,
+                          const std::vector<Coord<KeyType>>& spline_points)
+      : min_key_(min_key),
+        max_key_(max_key),
+        num_keys_(num_keys),
+        max_error_(max_error),
+        nodes_(std::move(nodes)),
+        entries_(std::move(entries)) {
+    spline_keys_.reserve(spline_points.size());
+    spline_positions_.reserve(spline_points.size());
+    for (const Coord<KeyType>& point : spline_points) {
+      spline_keys_.push_back(point.x);
+      spline_positions_.push_back(point.y);
+    }
+  }
+
+  // Returns the estimated position of `key`.
+  double GetEstimatedPosition(const KeyType key) const {
+    // Truncate to data boundaries.
+    if (key <= min_key_) return 0;
+    if (key >= max_key_) return num_keys_ - 1;
+
+    // Find spline segment with `key` ∈ (spline[index - 1], spline[index]].
+    const size_t index = GetSplineSegment(key);
+    return Interpolate(key, index);
+  }
+
+  // Returns a search bound [begin, end) around the estimated position.
+  SearchBound GetSearchBound(const KeyType key) const {
+    const size_t estimate = GetEstimatedPosition(key);
+    const size_t begin = (estimate < max_error_) ? 0 : (estimate - max_error_);
+    // `end` is exclusive.
+    const size_t end = (estimate + max_error_ + 2 > num_keys_)
+                           ? num_keys_
+                           : (estimate + max_error_ + 2);
+    return SearchBound{begin, end};
+  }
+
+  // Returns the number of radix table nodes.
+  size_t GetNumNodes() const { return nodes_.size(); }
+
+  // Returns the size in bytes.
+  size_t GetSize() const {
+    return sizeof(*this) + nodes_.size() * sizeof(Node) +
+           entries_.size() * sizeof(uint32_t) +
+           spline_keys_.size() * sizeof(KeyType) +
+           spline_positions_.size() * sizeof(double);
+  }
+
+ private:
+  // Returns the spline point index that `entry` stands for.
+  uint32_t GetBegin(uint32_t entry) const {
+    return (entry & kChildFlag) ? nodes_[entry & ~kChildFlag].begin : entry;
+  }
+
+  // Returns the index of the spline point that marks the end of the spline
+  // segment that contains the `key`: `key` ∈ (spline[index - 1], spline[index]]
+  size_t GetSplineSegment(const KeyType key) const {
+    // Descend to the node that holds the bucket of `key`.
+    const Node* node = &nodes_[0];
+    size_t index;
+    uint32_t entry;
+    while (true) {
+      index = node->offset + ((key - node->base) >> node->num_shift_bits);
+      entry = entries_[index];
+      if (!(entry & kChildFlag)) break;
+      node = &nodes_[entry & ~kChildFlag];
+    }
+    const uint32_t begin = entry;
+    const uint32_t end = GetBegin(entries_[index + 1]);
+    return begin + simd::LowerBound(spline_keys_.data() + begin, end - begin,
+                                    key);
+  }
+
+  // Interpolates the position of `key` on the spline segment ending at
+  // `index`.
+  double Interpolate(const KeyType key, const size_t index) const {
+    const KeyType down_x = spline_keys_[index - 1];
+    const double down_y = spline_positions_[index - 1];
+    const double x_diff = spline_keys_[index] - down_x;
+    const double y_diff = spline_positions_[index] - down_y;
+    const double slope = y_diff / x_diff;
+    return std::fma(key - down_x, slope, down_y);
+  }
+
+  KeyType min_key_;
+  KeyType max_key_;
+  size_t num_keys_;
+  size_t max_error_;
+
+  // `nodes_[0]` is the root.
+  std::vector<Node> nodes_;
+  AlignedVector<uint32_t> entries_;
+  AlignedVector<KeyType> spline_keys_;
+  AlignedVector<double> spline_positions_;
+};
+
+template <class KeyType>
+constexpr uint32_t HierarchicalRadixSpline<KeyType>::kChildFlag;
+
+}  // namespace rs
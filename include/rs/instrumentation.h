@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+namespace rs {
+
+// The path that a lookup on a `RadixSplineView` took. Only recorded if the
+// library is compiled with `RS_INSTRUMENT_LOOKUPS`, e.g., to explain tail
+// latencies, and otherwise compiled out entirely.
+struct LookupTrace {
+  // The key was not greater than the smallest or not smaller than the largest
+  // key, hence the spline was not searched.
+  bool clamped = false;
+  // Number of spline points in the radix table bucket of the key.
+  size_t segment_range = 0;
+  // The bucket was binary searched before the linear scan, see
+  // `simd::LowerBound`.
+  bool binary_segment_search = false;
+  // Width of the search bound around the estimated position.
+  size_t bound_width = 0;
+  // The result was outside of the search bound and the entire data was
+  // searched.
+  bool fallback = false;
+  // Number of elements that `EqualRange` returned.
+  size_t equal_range_size = 0;
+};
+
+namespace internal {
+
+inline LookupTrace*& CurrentLookupTrace() {
+  static thread_local LookupTrace* trace = nullptr;
+  return trace;
+}
+
+}  // namespace internal
+
+// Makes the lookups of the calling thread record their path in `trace`, or
+// stops recording if `trace` is null. Callers reset `trace` between lookups.
+inline void SetLookupTrace(LookupTrace* trace) {
+  internal::CurrentLookupTrace() = trace;
+}
+
+}  // namespace rs
+
+#ifdef RS_INSTRUMENT_LOOKUPS
+#define RS_TRACE_LOOKUP(field, value)                         \
+  do {                                                        \
+    if (::rs::internal::CurrentLookupTrace() != nullptr)      \
+      ::rs::internal::CurrentLookupTrace()->field = (value); \
+  } while (false)
+#else
+#define RS_TRACE_LOOKUP(field, value) \
+  do {                                \
+  } while (false)
+#endif
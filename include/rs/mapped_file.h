@@ -0,0 +1,58 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <string>
+
+namespace rs {
+
+// Maps a file read-only into memory. The mapping is shared, so that processes
+// that map the same file share its page-cached contents.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile() { Close(); }
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  // Maps the file at `path`. Returns false if it cannot be opened or mapped.
+  bool Open(const std::string& path) {
+    Close();
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat stats;
+    if (fstat(fd, &stats) != 0 || stats.st_size == 0) {
+      close(fd);
+      return false;
+    }
+    void* data = mmap(nullptr, stats.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping stays valid after closing the file descriptor.
+    close(fd);
+    if (data == MAP_FAILED) return false;
+    data_ = static_cast<const char*>(data);
+    size_ = stats.st_size;
+    return true;
+  }
+
+  // Unmaps the file, invalidates all views on it.
+  void Close() {
+    if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  // The mapping starts at a page boundary.
+  const char* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+}  // namespace rs
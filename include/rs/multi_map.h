@@ -1,35 +1,94 @@
 #pragma once
 
+#include <algorithm>
 #include <iterator>
 #include <limits>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include "builder.h"
+#include "multi_map_storage.h"
+#include "radix_sort.h"
 #include "radix_spline.h"
+#include "search.h"
 
 namespace rs {
 
 // A drop-in replacement for std::multimap. Internally creates a sorted copy of
-// the data.
-template <class KeyType, class ValueType>
+// the data. `SearchPolicy` finds keys within the search bounds of the spline,
+// see search.h. `StoragePolicy` lays out the elements, see
+// multi_map_storage.h.
+template <class KeyType, class ValueType, class SearchPolicy = BinarySearch,
+          class StoragePolicy = PairStorage>
 class MultiMap {
+ private:
+  using Elements =
+      typename StoragePolicy::template Elements<KeyType, ValueType>;
+
  public:
   // Member type definitions.
   using key_type = KeyType;
   using mapped_type = ValueType;
   using value_type = std::pair<KeyType, ValueType>;
   using size_type = std::size_t;
-  using iterator = typename std::vector<value_type>::iterator;
-  using const_iterator = typename std::vector<value_type>::const_iterator;
+  using const_iterator = typename Elements::const_iterator;
+  using iterator = const_iterator;
 
-  // Constructor, creates a copy of the data.
+  // Constructor, creates a copy of the data. Unsorted data is sorted with
+  // `num_threads` threads. `huge_pages` applies to the spline and the
+  // elements, see allocator.h.
   template <class BidirIt>
   MultiMap(BidirIt first, BidirIt last, size_t num_radix_bits = 18,
-           size_t max_error = 32);
+           size_t max_error = 32, size_t num_threads = 1,
+           HugePages huge_pages = HugePages::kNone);
+
+  // Constructor, takes over `data` without copying it.
+  explicit MultiMap(std::vector<value_type>&& data, size_t num_radix_bits = 18,
+                    size_t max_error = 32, size_t num_threads = 1,
+                    HugePages huge_pages = HugePages::kNone);
+
+  // A view on the contiguous elements in [begin, end), e.g., the result of
+  // `range`.
+  class Range {
+   public:
+    Range(const_iterator begin, const_iterator end)
+        : begin_(begin), end_(end) {}
+
+    const_iterator begin() const { return begin_; }
+    const_iterator end() const { return end_; }
+    size_type size() const { return end_ - begin_; }
+    bool empty() const { return begin_ == end_; }
+
+    // Calls `function(key, value)` on each element in order. Loops over the
+    // underlying arrays, so the compiler can vectorize the scan even with
+    // `SplitStorage`. Sequential reads are left to the hardware prefetcher.
+    template <class Function>
+    void ForEach(Function&& function) const {
+      Elements::ForEach(begin_, end_, std::forward<Function>(function));
+    }
+
+   private:
+    const_iterator begin_;
+    const_iterator end_;
+  };
 
   // Lookup functions, like in std::multimap.
   const_iterator find(KeyType key) const;
   const_iterator lower_bound(KeyType key) const;
+  const_iterator upper_bound(KeyType key) const;
+  std::pair<const_iterator, const_iterator> equal_range(KeyType key) const;
+  size_type count(KeyType key) const;
+
+  // Returns the elements with a key in [lo, hi). Resolves both ends through
+  // the spline and overlaps their cache misses, see `lower_bound_batch`.
+  Range range(KeyType lo, KeyType hi) const;
+
+  // Batched `lower_bound`, stores the result for `keys[i]` in `results[i]`.
+  // Overlaps the cache misses of independent lookups, see
+  // `RadixSpline::GetSearchBounds`.
+  void lower_bound_batch(const KeyType* keys, size_t num_keys,
+                         const_iterator* results) const;
 
   // Iterators.
   const_iterator begin() const { return data_.begin(); }
@@ -38,18 +97,71 @@ class MultiMap {
   // Size.
   std::size_t size() const { return data_.size(); }
 
+  // Returns the size of the index in bytes, excluding the elements.
+  size_t GetIndexSize() const { return rs_.GetSize(); }
+
  private:
-  std::vector<value_type> data_;
+  using GetKey = typename Elements::GetKey;
+
+  // True if the elements can be sorted with `RadixSort`.
+  static constexpr bool kRadixSortable =
+      std::is_unsigned<KeyType>::value &&
+      std::is_default_constructible<value_type>::value &&
+      std::is_move_assignable<value_type>::value;
+
+  // Sorts `data` by key, if necessary, and builds the map on it.
+  void Build(std::vector<value_type>&& data, size_t num_radix_bits,
+             size_t max_error, size_t num_threads, HugePages huge_pages);
+
+  // Sorts `data` by key, with `RadixSort` if the elements support it.
+  static void SortByKey(std::vector<value_type>* data, size_t num_threads,
+                        std::true_type /*radix_sortable*/) {
+    RadixSort(data, [](const value_type& element) { return element.first; },
+              num_threads);
+  }
+  static void SortByKey(std::vector<value_type>* data, size_t /*num_threads*/,
+                        std::false_type /*radix_sortable*/) {
+    std::stable_sort(data->begin(), data->end(),
+                     [](const value_type& lhs, const value_type& rhs) {
+                       return lhs.first < rhs.first;
+                     });
+  }
+
+  Elements data_;
   RadixSpline<KeyType> rs_;
 };
 
-template <class KeyType, class ValueType>
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+constexpr bool
+    MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::kRadixSortable;
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
 template <class BidirIt>
-MultiMap<KeyType, ValueType>::MultiMap(BidirIt first, BidirIt last,
-                                       size_t num_radix_bits,
-                                       size_t max_error) {
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::MultiMap(
+    BidirIt first, BidirIt last, size_t num_radix_bits, size_t max_error,
+    size_t num_threads, HugePages huge_pages) {
+  // Allocates once, the range constructor measures the input up front.
+  std::vector<value_type> data(first, last);
+  Build(std::move(data), num_radix_bits, max_error, num_threads, huge_pages);
+}
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::MultiMap(
+    std::vector<value_type>&& data, size_t num_radix_bits, size_t max_error,
+    size_t num_threads, HugePages huge_pages) {
+  Build(std::move(data), num_radix_bits, max_error, num_threads, huge_pages);
+}
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+void MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::Build(
+    std::vector<value_type>&& data, size_t num_radix_bits, size_t max_error,
+    size_t num_threads, HugePages huge_pages) {
   // Empty spline.
-  if (first == last) {
+  if (data.empty()) {
     rs::Builder<KeyType> rsb(std::numeric_limits<KeyType>::min(),
                              std::numeric_limits<KeyType>::max(),
                              num_radix_bits, max_error);
@@ -57,51 +169,124 @@ MultiMap<KeyType, ValueType>::MultiMap(BidirIt first, BidirIt last,
     return;
   }
 
-  // Copy data and check if sorted.
-  bool is_sorted = true;
-  KeyType previous_key = first->first;
-  for (auto current = first; current != last; ++current) {
-    is_sorted &= current->first >= previous_key;
-    previous_key = current->first;
-    data_.push_back(*current);
-  }
-
-  // Sort if necessary.
-  if (!is_sorted) {
-    std::sort(data_.begin(), data_.end(),
-              [](const value_type& lhs, const value_type& rhs) {
-                return lhs.first < rhs.first;
-              });
+  // Sort if necessary. Integer keys are radix sorted, which also keeps equal
+  // keys in their input order.
+  const auto key_less = [](const value_type& lhs, const value_type& rhs) {
+    return lhs.first < rhs.first;
+  };
+  if (!std::is_sorted(data.begin(), data.end(), key_less)) {
+    SortByKey(&data, num_threads,
+              std::integral_constant<bool, kRadixSortable>());
   }
 
   // Create spline builder.
-  const auto min_key = data_.front().first;
-  const auto max_key = data_.back().first;
-  rs::Builder<KeyType> rsb(min_key, max_key, num_radix_bits, max_error);
+  const auto min_key = data.front().first;
+  const auto max_key = data.back().first;
+  rs::Builder<KeyType> rsb(min_key, max_key, num_radix_bits, max_error,
+                           SplineLayout::kCompact, RadixTableEncoding::kPlain,
+                           huge_pages);
 
-  // Build the radix spline.
-  for (const auto& iter : data_) {
-    rsb.AddKey(iter.first);
-  }
+  // Lay out the elements and build the radix spline on their keys.
+  data_ = Elements(std::move(data), huge_pages);
+  rsb.AddKeys(data_.Keys(), data_.Keys() + data_.size(), GetKey());
   rs_ = rsb.Finalize();
 }
 
-template <class KeyType, class ValueType>
-typename MultiMap<KeyType, ValueType>::const_iterator
-MultiMap<KeyType, ValueType>::lower_bound(KeyType key) const {
-  SearchBound bound = rs_.GetSearchBound(key);
-  return std::lower_bound(data_.begin() + bound.begin,
-                          data_.begin() + bound.end, key,
-                          [](const value_type& lhs, const KeyType& rhs) {
-                            return lhs.first < rhs;
-                          });
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+typename MultiMap<KeyType, ValueType, SearchPolicy,
+                  StoragePolicy>::const_iterator
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::lower_bound(
+    KeyType key) const {
+  return data_.begin() +
+         rs_.template LowerBound<SearchPolicy>(data_.Keys(), key, GetKey());
+}
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+void MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::
+    lower_bound_batch(const KeyType* keys, size_t num_keys,
+                      const_iterator* results) const {
+  constexpr size_t kBatchSize = RadixSpline<KeyType>::kBatchSize;
+  if (data_.size() == 0) {
+    std::fill(results, results + num_keys, data_.end());
+    return;
+  }
+  SearchBound bounds[kBatchSize];
+  double estimates[kBatchSize];
+  for (size_t offset = 0; offset < num_keys; offset += kBatchSize) {
+    const size_t batch_size = std::min(kBatchSize, num_keys - offset);
+    rs_.GetSearchBounds(keys + offset, batch_size, bounds, estimates);
+
+    // Prefetch the estimated positions, where the searches start.
+    for (size_t i = 0; i < batch_size; ++i)
+      data_.Prefetch(static_cast<size_t>(estimates[i]));
+
+    for (size_t i = 0; i < batch_size; ++i) {
+      results[offset + i] =
+          data_.begin() + rs_.template LowerBoundWithin<SearchPolicy>(
+                              data_.Keys(), bounds[i], estimates[i],
+                              keys[offset + i], GetKey());
+    }
+  }
 }
 
-template <class KeyType, class ValueType>
-typename MultiMap<KeyType, ValueType>::const_iterator
-MultiMap<KeyType, ValueType>::find(KeyType key) const {
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+typename MultiMap<KeyType, ValueType, SearchPolicy,
+                  StoragePolicy>::const_iterator
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::find(
+    KeyType key) const {
   auto iter = lower_bound(key);
   return iter != data_.end() && iter->first == key ? iter : data_.end();
 }
 
-}  // namespace rs
\ No newline at end of file
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+typename MultiMap<KeyType, ValueType, SearchPolicy,
+                  StoragePolicy>::const_iterator
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::upper_bound(
+    KeyType key) const {
+  return equal_range(key).second;
+}
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+std::pair<typename MultiMap<KeyType, ValueType, SearchPolicy,
+                            StoragePolicy>::const_iterator,
+          typename MultiMap<KeyType, ValueType, SearchPolicy,
+                            StoragePolicy>::const_iterator>
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::equal_range(
+    KeyType key) const {
+  // Gallops from the lower bound to the end of the duplicates, which is
+  // cheaper than a second lookup for short runs.
+  const std::pair<size_t, size_t> range =
+      rs_.template EqualRange<SearchPolicy>(data_.Keys(), key, GetKey());
+  return {data_.begin() + range.first, data_.begin() + range.second};
+}
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+typename MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::size_type
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::count(
+    KeyType key) const {
+  const auto range = equal_range(key);
+  return range.second - range.first;
+}
+
+template <class KeyType, class ValueType, class SearchPolicy,
+          class StoragePolicy>
+typename MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::Range
+MultiMap<KeyType, ValueType, SearchPolicy, StoragePolicy>::range(
+    KeyType lo, KeyType hi) const {
+  if (!(lo < hi)) {
+    const const_iterator iter = lower_bound(lo);
+    return Range(iter, iter);
+  }
+  const KeyType keys[2] = {lo, hi};
+  const_iterator results[2];
+  lower_bound_batch(keys, 2, results);
+  return Range(results[0], results[1]);
+}
+
+}  // namespace rs
@@ -0,0 +1,228 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "allocator.h"
+#include "search.h"
+
+namespace rs {
+
+// Storage policies of `MultiMap`. Each policy provides `Elements<KeyType,
+// ValueType>`, which holds the sorted elements and offers:
+// - `const_iterator`, a random access iterator over
+//   `std::pair<KeyType, ValueType>`, and `begin`, `end`, `size`.
+// - `Keys`, an iterator over the elements that the spline searches, and
+//   `GetKey`, which returns the key of such an element.
+// - `Prefetch(position)`, which prefetches what a search at `position` reads.
+// - `ForEach(begin, end, function)`, which calls `function(key, value)` on
+//   the elements in [begin, end) with a plain loop over the arrays.
+// The constructor takes the sorted elements and the `HugePages` mode of the
+// arrays.
+
+// Stores the elements as an array of pairs, i.e., a value is next to its key.
+// Best for small values and for scans that read most values.
+struct PairStorage {
+  template <class KeyType, class ValueType>
+  class Elements {
+   public:
+    using value_type = std::pair<KeyType, ValueType>;
+    using const_iterator = typename std::vector<value_type>::const_iterator;
+
+    // Returns the key of an element.
+    struct GetKey {
+      KeyType operator()(const value_type& element) const {
+        return element.first;
+      }
+    };
+
+    Elements() = default;
+
+    // Takes over `sorted`, which needs to be sorted by key. The array is
+    // already allocated, hence huge pages are only advised.
+    explicit Elements(std::vector<value_type>&& sorted,
+                      HugePages huge_pages = HugePages::kNone)
+        : data_(std::move(sorted)) {
+      if (huge_pages != HugePages::kNone)
+        AdviseHugePages(data_.data(), data_.size() * sizeof(value_type));
+    }
+
+    const_iterator begin() const { return data_.begin(); }
+    const_iterator end() const { return data_.end(); }
+    size_t size() const { return data_.size(); }
+
+    const_iterator Keys() const { return data_.begin(); }
+
+    void Prefetch(size_t position) const {
+      __builtin_prefetch(data_.data() + position);
+    }
+
+    template <class Function>
+    static void ForEach(const_iterator begin, const_iterator end,
+                        Function&& function) {
+      if (begin == end) return;
+      const value_type* data = &*begin;
+      const size_t size = end - begin;
+      for (size_t i = 0; i < size; ++i) function(data[i].first, data[i].second);
+    }
+
+   private:
+    std::vector<value_type> data_;
+  };
+};
+
+// Stores keys and values in separate arrays. The search then only reads the
+// dense key array, and a value is only read when the iterator is dereferenced,
+// i.e., on a hit. Best for wide values. Dereferencing an iterator returns a
+// `std::pair` of references instead of a reference to a pair.
+struct SplitStorage {
+  template <class KeyType, class ValueType>
+  class Elements {
+   public:
+    using value_type = std::pair<KeyType, ValueType>;
+    using GetKey = KeyIdentity;
+
+    class const_iterator;
+
+    Elements() = default;
+
+    // Splits `sorted`, which needs to be sorted by key, and releases it.
+    explicit Elements(std::vector<value_type>&& sorted,
+                      HugePages huge_pages = HugePages::kNone)
+        : keys_(AlignedAllocator<KeyType>(huge_pages)),
+          values_(AlignedAllocator<ValueType>(huge_pages)) {
+      keys_.reserve(sorted.size());
+      values_.reserve(sorted.size());
+      for (value_type& element : sorted) {
+        keys_.push_back(element.first);
+        values_.push_back(std::move(element.second));
+      }
+      std::vector<value_type>().swap(sorted);
+    }
+
+    const_iterator begin() const {
+      return const_iterator(keys_.data(), values_.data());
+    }
+    const_iterator end() const { return begin() + keys_.size(); }
+    size_t size() const { return keys_.size(); }
+
+    const KeyType* Keys() const { return keys_.data(); }
+
+    void Prefetch(size_t position) const {
+      __builtin_prefetch(keys_.data() + position);
+    }
+
+    // Reads the key and value arrays directly instead of zipping them.
+    template <class Function>
+    static void ForEach(const_iterator begin, const_iterator end,
+                        Function&& function) {
+      const KeyType* keys = begin.key_;
+      const ValueType* values = begin.value_;
+      const size_t size = end - begin;
+      for (size_t i = 0; i < size; ++i) function(keys[i], values[i]);
+    }
+
+   private:
+    AlignedVector<KeyType> keys_;
+    AlignedVector<ValueType> values_;
+  };
+};
+
+// Iterates over the key and the value array in lockstep.
+template <class KeyType, class ValueType>
+class SplitStorage::Elements<KeyType, ValueType>::const_iterator {
+ public:
+  using iterator_category = std::random_access_iterator_tag;
+  using value_type = std::pair<KeyType, ValueType>;
+  using difference_type = std::ptrdiff_t;
+  using reference = std::pair<const KeyType&, const ValueType&>;
+
+  // Supports `iter->first` and `iter->second`.
+  class pointer {
+   public:
+    explicit pointer(reference element) : element_(element) {}
+    const reference* operator->() const { return &element_; }
+
+   private:
+    reference element_;
+  };
+
+  const_iterator() = default;
+
+  reference operator*() const { return reference(*key_, *value_); }
+  pointer operator->() const { return pointer(**this); }
+  reference operator[](difference_type n) const { return *(*this + n); }
+
+  const_iterator& operator++() {
+    ++key_;
+    ++value_;
+    return *this;
+  }
+  const_iterator operator++(int) {
+    const_iterator result = *this;
+    ++*this;
+    return result;
+  }
+  const_iterator& operator--() {
+    --key_;
+    --value_;
+    return *this;
+  }
+  const_iterator operator--(int) {
+    const_iterator result = *this;
+    --*this;
+    return result;
+  }
+  const_iterator& operator+=(difference_type n) {
+    key_ += n;
+    value_ += n;
+    return *this;
+  }
+  const_iterator& operator-=(difference_type n) { return *this += -n; }
+  const_iterator operator+(difference_type n) const {
+    const_iterator result = *this;
+    return result += n;
+  }
+  friend const_iterator operator+(difference_type n, const_iterator iter) {
+    return iter += n;
+  }
+  const_iterator operator-(difference_type n) const {
+    const_iterator result = *this;
+    return result -= n;
+  }
+  difference_type operator-(const const_iterator& other) const {
+    return key_ - other.key_;
+  }
+
+  bool operator==(const const_iterator& other) const {
+    return key_ == other.key_;
+  }
+  bool operator!=(const const_iterator& other) const {
+    return key_ != other.key_;
+  }
+  bool operator<(const const_iterator& other) const {
+    return key_ < other.key_;
+  }
+  bool operator>(const const_iterator& other) const {
+    return key_ > other.key_;
+  }
+  bool operator<=(const const_iterator& other) const {
+    return key_ <= other.key_;
+  }
+  bool operator>=(const const_iterator& other) const {
+    return key_ >= other.key_;
+  }
+
+ private:
+  const_iterator(const KeyType* key, const ValueType* value)
+      : key_(key), value_(value) {}
+
+  const KeyType* key_ = nullptr;
+  const ValueType* value_ = nullptr;
+
+  friend class Elements;
+};
+
+}  // namespace rs
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace rs {
+namespace internal {
+
+// Runs `task(0)`, ..., `task(num_tasks - 1)` on separate threads, the first
+// one on the calling thread.
+template <class Task>
+void RunInParallel(size_t num_tasks, const Task& task) {
+  std::vector<std::thread> threads;
+  threads.reserve(num_tasks - 1);
+  for (size_t i = 1; i < num_tasks; ++i) threads.emplace_back(task, i);
+  task(0);
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace internal
+}  // namespace rs
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+#include "builder.h"
+#include "common.h"
+#include "parallel.h"
+#include "radix_spline.h"
+
+namespace rs {
+
+// Builds a `RadixSpline` over a sorted array of keys with multiple threads.
+//
+// The keys are split into one chunk per thread at distinct key boundaries and
+// the spline of each chunk is fitted concurrently with the same
+// `GreedySplineCorridor` as `Builder`. Each chunk additionally fits the first
+// key of the next chunk, so that adjacent chunk splines share their boundary
+// point and the concatenated spline keeps the `max_error` guarantee. Restarting
+// the corridor at chunk boundaries may add up to one spline point per chunk
+// compared to `Builder`. The radix table is filled in parallel as well. With
+// `ErrorBounds::kPerSegment`, each chunk also measures the errors of its
+// segments, including the one that ends at the first key of the next chunk.
+template <class KeyType>
+class ParallelBuilder {
+ public:
+  ParallelBuilder(size_t num_threads, size_t num_radix_bits = 18,
+                  size_t max_error = 32,
+                  SplineLayout spline_layout = SplineLayout::kCompact,
+                  RadixTableEncoding radix_table_encoding =
+                      RadixTableEncoding::kPlain,
+                  ErrorBounds error_bounds = ErrorBounds::kGlobal)
+      : num_threads_(std::max<size_t>(num_threads, 1)),
+        num_radix_bits_(num_radix_bits),
+        max_error_(max_error),
+        spline_layout_(spline_layout),
+        radix_table_encoding_(radix_table_encoding),
+        error_bounds_(error_bounds) {}
+
+  // Builds a `RadixSpline` over the `num_keys` sorted `keys`, which need to
+  // be non-empty.
+  RadixSpline<KeyType> Build(const KeyType* keys, size_t num_keys) const {
+    assert(num_keys > 0);
+    const KeyType min_key = keys[0];
+    const KeyType max_key = keys[num_keys - 1];
+
+    const std::vector<size_t> chunks = GetChunkBoundaries(keys, num_keys);
+    const size_t num_chunks = chunks.size() - 1;
+    if (num_chunks < 2) {
+      // Not worth spawning threads.
+      Builder<KeyType> rsb(min_key, max_key, num_radix_bits_, max_error_,
+                           spline_layout_, radix_table_encoding_,
+                           HugePages::kNone, error_bounds_);
+      rsb.AddKeys(keys, keys + num_keys);
+      return rsb.Finalize();
+    }
+
+    // Fit the spline of each chunk.
+    std::vector<std::vector<Coord<KeyType>>> chunk_splines(num_chunks);
+    std::vector<std::vector<uint8_t>> chunk_segment_errors(num_chunks);
+    internal::RunInParallel(num_chunks, [&](size_t chunk) {
+      FitChunk(keys, chunks[chunk], chunks[chunk + 1], num_keys,
+               &chunk_splines[chunk], &chunk_segment_errors[chunk]);
+    });
+
+    // Concatenate the chunk splines, skipping the shared boundary points.
+    size_t num_spline_points = 1;
+    for (const auto& chunk_spline : chunk_splines)
+      num_spline_points += chunk_spline.size() - 1;
+    std::vector<Coord<KeyType>> spline_points;
+    spline_points.reserve(num_spline_points);
+    spline_points.push_back(chunk_splines[0][0]);
+    for (const auto& chunk_spline : chunk_splines) {
+      assert(chunk_spline.front().x == spline_points.back().x);
+      spline_points.insert(spline_points.end(), chunk_spline.begin() + 1,
+                           chunk_spline.end());
+    }
+    // Same for the errors, two per spline point.
+    std::vector<uint8_t> segment_errors;
+    if (error_bounds_ == ErrorBounds::kPerSegment) {
+      segment_errors.reserve(2 * num_spline_points);
+      segment_errors.insert(segment_errors.end(),
+                            chunk_segment_errors[0].begin(),
+                            chunk_segment_errors[0].begin() + 2);
+      for (const auto& chunk_errors : chunk_segment_errors)
+        segment_errors.insert(segment_errors.end(), chunk_errors.begin() + 2,
+                              chunk_errors.end());
+    }
+
+    // Fill the radix table.
+    const size_t num_shift_bits =
+        Builder<KeyType>::GetNumShiftBits(max_key - min_key, num_radix_bits_);
+    const size_t max_prefix = (max_key - min_key) >> num_shift_bits;
+    AlignedVector<uint32_t> radix_table(max_prefix + 2);
+    const size_t points_per_thread =
+        (spline_points.size() + num_threads_ - 1) / num_threads_;
+    internal::RunInParallel(num_threads_, [&](size_t thread) {
+      const size_t begin =
+          std::min(thread * points_per_thread, spline_points.size());
+      const size_t end =
+          std::min(begin + points_per_thread, spline_points.size());
+      FillRadixTable(spline_points, begin, end, min_key, num_shift_bits,
+                     &radix_table);
+    });
+
+    return RadixSpline<KeyType>(
+        min_key, max_key, num_keys, num_radix_bits_, num_shift_bits,
+        max_error_, RadixTable(std::move(radix_table), radix_table_encoding_),
+        spline_points, spline_layout_, HugePages::kNone, segment_errors);
+  }
+
+ private:
+  // Returns the first position of each chunk followed by `num_keys`. Chunks
+  // start at a new distinct key and the last chunk contains at least two
+  // distinct keys.
+  std::vector<size_t> GetChunkBoundaries(const KeyType* keys,
+                                         size_t num_keys) const {
+    std::vector<size_t> chunks = {0};
+    const size_t chunk_size = (num_keys + num_threads_ - 1) / num_threads_;
+    for (size_t chunk = 1; chunk < num_threads_; ++chunk) {
+      size_t begin = std::max(chunk * chunk_size, chunks.back() + 1);
+      while (begin < num_keys && keys[begin] == keys[begin - 1]) ++begin;
+      if (begin >= num_keys || keys[begin] == keys[num_keys - 1]) break;
+      chunks.push_back(begin);
+    }
+    chunks.push_back(num_keys);
+    return chunks;
+  }
+
+  // Fits the spline of the keys in [begin, end) plus, unless `end` is
+  // `num_keys`, the first key of the next chunk. Stores its points in
+  // `spline_points` and, for `ErrorBounds::kPerSegment`, their errors in
+  // `segment_errors`.
+  void FitChunk(const KeyType* keys, size_t begin, size_t end, size_t num_keys,
+                std::vector<Coord<KeyType>>* spline_points,
+                std::vector<uint8_t>* segment_errors) const {
+    const size_t last = (end < num_keys) ? end : num_keys - 1;
+    // Only the spline is used, the radix table of the chunk stays minimal.
+    Builder<KeyType> rsb(keys[begin], keys[last], /*num_radix_bits=*/1,
+                         max_error_, SplineLayout::kCompact,
+                         RadixTableEncoding::kPlain, HugePages::kNone,
+                         error_bounds_);
+    for (size_t position = begin; position < end; ++position)
+      rsb.AddKey(keys[position], position);
+    if (end < num_keys) rsb.AddKey(keys[end], end);
+    rsb.FinalizeSpline();
+    *spline_points = std::move(rsb.spline_points_);
+    *segment_errors = std::move(rsb.segment_errors_);
+  }
+
+  // Fills the entries of `radix_table` that point to the spline points in
+  // [begin, end). Each entry holds the index of the first spline point whose
+  // prefix is at least as large as the entry's prefix. Threads write disjoint
+  // ranges.
+  static void FillRadixTable(const std::vector<Coord<KeyType>>& spline_points,
+                             size_t begin, size_t end, KeyType min_key,
+                             size_t num_shift_bits,
+                             AlignedVector<uint32_t>* radix_table) {
+    if (begin == end) return;
+    const auto get_prefix = [&](size_t index) -> size_t {
+      return (spline_points[index].x - min_key) >> num_shift_bits;
+    };
+    size_t prefix = (begin == 0) ? 0 : get_prefix(begin - 1) + 1;
+    for (size_t index = begin; index < end; ++index) {
+      const size_t curr_prefix = get_prefix(index);
+      for (; prefix <= curr_prefix; ++prefix) (*radix_table)[prefix] = index;
+    }
+    if (end == spline_points.size()) {
+      for (; prefix < radix_table->size(); ++prefix)
+        (*radix_table)[prefix] = spline_points.size();
+    }
+  }
+
+  const size_t num_threads_;
+  const size_t num_radix_bits_;
+  const size_t max_error_;
+  const SplineLayout spline_layout_;
+  const RadixTableEncoding radix_table_encoding_;
+  const ErrorBounds error_bounds_;
+};
+
+}  // namespace rs
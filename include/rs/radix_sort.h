@@ -0,0 +1,242 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "parallel.h"
+
+namespace rs {
+namespace internal {
+
+// Most-significant-digit radix sort on 8-bit digits, see `RadixSort`.
+template <class Element, class GetKey>
+class RadixSorter {
+ public:
+  using KeyType =
+      typename std::decay<decltype(std::declval<GetKey>()(
+          std::declval<const Element&>()))>::type;
+  static_assert(std::is_unsigned<KeyType>::value,
+                "RadixSort needs unsigned integer keys");
+
+  static constexpr int kDigitBits = 8;
+  static constexpr size_t kNumBuckets = size_t{1} << kDigitBits;
+  // Buckets up to this size are insertion sorted.
+  static constexpr size_t kMaxInsertionSortSize = 64;
+  // Smallest chunk of the first pass that is worth a thread.
+  static constexpr size_t kMinChunkSize = size_t{1} << 16;
+
+  using Histogram = std::array<size_t, kNumBuckets>;
+
+  explicit RadixSorter(const GetKey& get_key) : get_key_(get_key) {}
+
+  void Sort(std::vector<Element>* data, size_t num_threads) const {
+    const size_t size = data->size();
+    if (size <= kMaxInsertionSortSize) {
+      InsertionSort(data->data(), size);
+      return;
+    }
+    std::vector<Element> scratch(size);
+    num_threads =
+        std::max<size_t>(1, std::min(num_threads, size / kMinChunkSize));
+    if (num_threads == 1) {
+      SortInPlace(data->data(), scratch.data(), size, kTopShift);
+    } else {
+      SortInPlaceParallel(data->data(), scratch.data(), size, num_threads);
+    }
+  }
+
+ private:
+  static constexpr int kTopShift =
+      static_cast<int>(sizeof(KeyType) * 8) - kDigitBits;
+
+  size_t GetDigit(const Element& element, int shift) const {
+    return (get_key_(element) >> shift) & (kNumBuckets - 1);
+  }
+
+  // Returns the histogram of the digit at `shift` of [data, data + size).
+  Histogram Count(const Element* data, size_t size, int shift) const {
+    Histogram histogram;
+    histogram.fill(0);
+    for (size_t i = 0; i < size; ++i) ++histogram[GetDigit(data[i], shift)];
+    return histogram;
+  }
+
+  // Moves [source, source + size) to `target` into the buckets of the digit at
+  // `shift`, whose next free positions are in `next`. Keeps the order within
+  // each bucket.
+  void Scatter(Element* source, size_t size, int shift, Element* target,
+               Histogram* next) const {
+    for (size_t i = 0; i < size; ++i) {
+      Element& element = source[i];
+      target[(*next)[GetDigit(element, shift)]++] = std::move(element);
+    }
+  }
+
+  // Stable.
+  void InsertionSort(Element* data, size_t size) const {
+    for (size_t i = 1; i < size; ++i) {
+      if (!(get_key_(data[i]) < get_key_(data[i - 1]))) continue;
+      Element element = std::move(data[i]);
+      const KeyType key = get_key_(element);
+      size_t j = i;
+      for (; j > 0 && key < get_key_(data[j - 1]); --j)
+        data[j] = std::move(data[j - 1]);
+      data[j] = std::move(element);
+    }
+  }
+
+  // Sorts [data, data + size) by the digits at `shift` and below, using
+  // `scratch` of the same size.
+  void SortInPlace(Element* data, Element* scratch, size_t size,
+                   int shift) const {
+    for (;; shift -= kDigitBits) {
+      if (size <= kMaxInsertionSortSize) {
+        InsertionSort(data, size);
+        return;
+      }
+      if (shift < 0) return;
+      const Histogram counts = Count(data, size, shift);
+      // Skip digits that are equal for all keys.
+      if (std::find(counts.begin(), counts.end(), size) != counts.end())
+        continue;
+      Histogram next = GetOffsets(counts);
+      Scatter(data, size, shift, scratch, &next);
+      SortBuckets(counts, scratch, data, shift);
+      return;
+    }
+  }
+
+  // Like `SortInPlace`, but stores the result in `target` and uses `source`
+  // as scratch.
+  void SortTo(Element* source, Element* target, size_t size,
+              int shift) const {
+    for (;; shift -= kDigitBits) {
+      if (size <= kMaxInsertionSortSize || shift < 0) {
+        std::move(source, source + size, target);
+        InsertionSort(target, size);
+        return;
+      }
+      const Histogram counts = Count(source, size, shift);
+      if (std::find(counts.begin(), counts.end(), size) != counts.end())
+        continue;
+      Histogram next = GetOffsets(counts);
+      Scatter(source, size, shift, target, &next);
+      size_t offset = 0;
+      for (const size_t count : counts) {
+        SortInPlace(target + offset, source + offset, count,
+                    shift - kDigitBits);
+        offset += count;
+      }
+      return;
+    }
+  }
+
+  // Sorts each bucket of `counts` in `source` by the lower digits and stores
+  // the result at the same position of `target`.
+  void SortBuckets(const Histogram& counts, Element* source, Element* target,
+                   int shift) const {
+    size_t offset = 0;
+    for (const size_t count : counts) {
+      SortTo(source + offset, target + offset, count, shift - kDigitBits);
+      offset += count;
+    }
+  }
+
+  // `SortInPlace` with `num_threads` threads. The first pass counts and
+  // scatters chunks concurrently, then threads take whole buckets.
+  void SortInPlaceParallel(Element* data, Element* scratch, size_t size,
+                           size_t num_threads) const {
+    const auto get_chunk = [&](size_t thread) {
+      return std::make_pair(thread * size / num_threads,
+                            (thread + 1) * size / num_threads);
+    };
+    for (int shift = kTopShift; shift >= 0; shift -= kDigitBits) {
+      std::vector<Histogram> chunk_counts(num_threads);
+      RunInParallel(num_threads, [&](size_t thread) {
+        const auto chunk = get_chunk(thread);
+        chunk_counts[thread] =
+            Count(data + chunk.first, chunk.second - chunk.first, shift);
+      });
+      Histogram counts;
+      counts.fill(0);
+      for (const Histogram& chunk_count : chunk_counts) {
+        for (size_t bucket = 0; bucket < kNumBuckets; ++bucket)
+          counts[bucket] += chunk_count[bucket];
+      }
+      if (std::find(counts.begin(), counts.end(), size) != counts.end())
+        continue;
+
+      // Each chunk writes its elements of a bucket after the ones of the
+      // previous chunks, which keeps the sort stable.
+      std::vector<Histogram> next(num_threads);
+      size_t offset = 0;
+      for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+        for (size_t thread = 0; thread < num_threads; ++thread) {
+          next[thread][bucket] = offset;
+          offset += chunk_counts[thread][bucket];
+        }
+      }
+      RunInParallel(num_threads, [&](size_t thread) {
+        const auto chunk = get_chunk(thread);
+        Scatter(data + chunk.first, chunk.second - chunk.first, shift,
+                scratch, &next[thread]);
+      });
+
+      const Histogram begins = GetOffsets(counts);
+      std::atomic<size_t> next_bucket(0);
+      RunInParallel(num_threads, [&](size_t) {
+        for (size_t bucket = next_bucket++; bucket < kNumBuckets;
+             bucket = next_bucket++) {
+          SortTo(scratch + begins[bucket], data + begins[bucket],
+                 counts[bucket], shift - kDigitBits);
+        }
+      });
+      return;
+    }
+  }
+
+  // Returns the first position of each bucket.
+  static Histogram GetOffsets(const Histogram& counts) {
+    Histogram offsets;
+    size_t offset = 0;
+    for (size_t bucket = 0; bucket < kNumBuckets; ++bucket) {
+      offsets[bucket] = offset;
+      offset += counts[bucket];
+    }
+    return offsets;
+  }
+
+  const GetKey& get_key_;
+};
+
+template <class Element, class GetKey>
+constexpr int RadixSorter<Element, GetKey>::kDigitBits;
+template <class Element, class GetKey>
+constexpr size_t RadixSorter<Element, GetKey>::kNumBuckets;
+template <class Element, class GetKey>
+constexpr size_t RadixSorter<Element, GetKey>::kMaxInsertionSortSize;
+template <class Element, class GetKey>
+constexpr size_t RadixSorter<Element, GetKey>::kMinChunkSize;
+template <class Element, class GetKey>
+constexpr int RadixSorter<Element, GetKey>::kTopShift;
+
+}  // namespace internal
+
+// Sorts `data` by the unsigned integer key that `get_key` returns for each
+// element. Stable. Runs a most-significant-digit radix sort on 8-bit digits,
+// which skips digits that are equal for all keys of a bucket and insertion
+// sorts small buckets. With `num_threads` > 1, the first pass runs on disjoint
+// chunks concurrently and the threads then sort whole buckets. Needs a scratch
+// array of the same size as `data`.
+template <class Element, class GetKey>
+void RadixSort(std::vector<Element>* data, const GetKey& get_key,
+               size_t num_threads = 1) {
+  internal::RadixSorter<Element, GetKey>(get_key).Sort(data, num_threads);
+}
+
+}  // namespace rs
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <algorithm>
-#include <cassert>
-#include <cmath>
+#include <utility>
 #include <vector>
 
+#include "allocator.h"
 #include "common.h"
+#include "radix_spline_view.h"
+#include "radix_table.h"
 
 namespace rs {
 
@@ -16,10 +18,15 @@ class RadixSpline {
  public:
   RadixSpline() = default;
 
+  // `segment_errors` holds two bytes per spline point for
+  // `ErrorBounds::kPerSegment`, see `RadixSplineView`, and is empty otherwise.
   RadixSpline(KeyType min_key, KeyType max_key, size_t num_keys,
               size_t num_radix_bits, size_t num_shift_bits, size_t max_error,
-              std::vector<uint32_t> radix_table,
-              std::vector<rs::Coord<KeyType>> spline_points)
+              RadixTable radix_table,
+              const std::vector<rs::Coord<KeyType>>& spline_points,
+              SplineLayout layout = SplineLayout::kCompact,
+              HugePages huge_pages = HugePages::kNone,
+              const std::vector<uint8_t>& segment_errors = {})
       : min_key_(min_key),
         max_key_(max_key),
         num_keys_(num_keys),
@@ -27,70 +34,165 @@ class RadixSpline {
         num_shift_bits_(num_shift_bits),
         max_error_(max_error),
         radix_table_(std::move(radix_table)),
-        spline_points_(std::move(spline_points)) {}
+        spline_keys_(AlignedAllocator<KeyType>(huge_pages)),
+        spline_positions_(AlignedAllocator<double>(huge_pages)),
+        spline_slopes_(AlignedAllocator<double>(huge_pages)),
+        segment_errors_(segment_errors.begin(), segment_errors.end(),
+                        AlignedAllocator<uint8_t>(huge_pages)) {
+    // Store the keys and positions of the spline points in separate arrays,
+    // so that segment searches only touch (and vectorize over) the keys.
+    spline_keys_.reserve(spline_points.size());
+    spline_positions_.reserve(spline_points.size());
+    for (const Coord<KeyType>& point : spline_points) {
+      spline_keys_.push_back(point.x);
+      spline_positions_.push_back(point.y);
+    }
+    if (layout == SplineLayout::kPrecomputedSlopes) ComputeSlopes();
+  }
+
+  // Takes a plain radix table as a vector, the signature of earlier versions.
+  RadixSpline(KeyType min_key, KeyType max_key, size_t num_keys,
+              size_t num_radix_bits, size_t num_shift_bits, size_t max_error,
+              const std::vector<uint32_t>& radix_table,
+              const std::vector<rs::Coord<KeyType>>& spline_points)
+      : RadixSpline(min_key, max_key, num_keys, num_radix_bits, num_shift_bits,
+                    max_error,
+                    RadixTable(AlignedVector<uint32_t>(radix_table.begin(),
+                                                       radix_table.end()),
+                               RadixTableEncoding::kPlain),
+                    spline_points) {}
+
+  // Copies the model that `view` points to.
+  explicit RadixSpline(const RadixSplineView<KeyType>& view)
+      : min_key_(view.min_key_),
+        max_key_(view.max_key_),
+        num_keys_(view.num_keys_),
+        num_radix_bits_(view.num_radix_bits_),
+        num_shift_bits_(view.num_shift_bits_),
+        max_error_(view.max_error_),
+        radix_table_(view.radix_table_),
+        spline_keys_(view.spline_keys_,
+                     view.spline_keys_ + view.num_spline_points_),
+        spline_positions_(view.spline_positions_,
+                          view.spline_positions_ + view.num_spline_points_) {
+    if (view.spline_slopes_ != nullptr) {
+      spline_slopes_.assign(view.spline_slopes_,
+                            view.spline_slopes_ + view.num_spline_points_);
+    }
+    if (view.segment_errors_ != nullptr) {
+      segment_errors_.assign(
+          view.segment_errors_,
+          view.segment_errors_ + 2 * view.num_spline_points_);
+    }
+  }
+
+  // Number of lookups that `GetSearchBounds` interleaves.
+  static constexpr size_t kBatchSize = RadixSplineView<KeyType>::kBatchSize;
+
+  // Returns a view on this model. All lookups go through the view, which is
+  // cheap to create.
+  RadixSplineView<KeyType> View() const {
+    return RadixSplineView<KeyType>(
+        min_key_, max_key_, num_keys_, num_radix_bits_, num_shift_bits_,
+        max_error_, radix_table_.View(), spline_keys_.data(),
+        spline_positions_.data(),
+        spline_slopes_.empty() ? nullptr : spline_slopes_.data(),
+        spline_keys_.size(),
+        segment_errors_.empty() ? nullptr : segment_errors_.data());
+  }
 
   // Returns the estimated position of `key`.
   double GetEstimatedPosition(const KeyType key) const {
-    // Truncate to data boundaries.
-    if (key <= min_key_) return 0;
-    if (key >= max_key_) return num_keys_ - 1;
-
-    // Find spline segment with `key` ∈ (spline[index - 1], spline[index]].
-    const size_t index = GetSplineSegment(key);
-    const Coord<KeyType> down = spline_points_[index - 1];
-    const Coord<KeyType> up = spline_points_[index];
-
-    // Compute slope.
-    const double x_diff = up.x - down.x;
-    const double y_diff = up.y - down.y;
-    const double slope = y_diff / x_diff;
-
-    // Interpolate.
-    const double key_diff = key - down.x;
-    return std::fma(key_diff, slope, down.y);
+    return View().GetEstimatedPosition(key);
   }
 
   // Returns a search bound [begin, end) around the estimated position.
   SearchBound GetSearchBound(const KeyType key) const {
-    const size_t estimate = GetEstimatedPosition(key);
-    const size_t begin = (estimate < max_error_) ? 0 : (estimate - max_error_);
-    // `end` is exclusive.
-    const size_t end = (estimate + max_error_ + 2 > num_keys_)
-                           ? num_keys_
-                           : (estimate + max_error_ + 2);
-    return SearchBound{begin, end};
+    return View().GetSearchBound(key);
+  }
+
+  // Returns a search bound [begin, end) around `estimated_position`, e.g., the
+  // result of `GetEstimatedPosition`.
+  SearchBound GetSearchBoundAround(const double estimated_position) const {
+    return View().GetSearchBoundAround(estimated_position);
+  }
+
+  // Returns the position of the first element of `data` whose key is not
+  // smaller than `key`, see `RadixSplineView::LowerBound`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  size_t LowerBound(Iterator data, const KeyType key,
+                    const GetKey& get_key = GetKey()) const {
+    return View().template LowerBound<SearchPolicy>(data, key, get_key);
+  }
+
+  // Like `LowerBound`, but starts from a known `bound`, see
+  // `RadixSplineView::LowerBoundWithin`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  size_t LowerBoundWithin(Iterator data, const SearchBound bound,
+                          const double estimated_position, const KeyType key,
+                          const GetKey& get_key = GetKey()) const {
+    return View().template LowerBoundWithin<SearchPolicy>(
+        data, bound, estimated_position, key, get_key);
+  }
+
+  // Returns the range of positions whose key equals `key`, see
+  // `RadixSplineView::EqualRange`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  std::pair<size_t, size_t> EqualRange(Iterator data, const KeyType key,
+                                       const GetKey& get_key = GetKey()) const {
+    return View().template EqualRange<SearchPolicy>(data, key, get_key);
+  }
+
+  // Like `EqualRange`, but starts from a known `bound`, see
+  // `RadixSplineView::EqualRangeWithin`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  std::pair<size_t, size_t> EqualRangeWithin(
+      Iterator data, const SearchBound bound, const double estimated_position,
+      const KeyType key, const GetKey& get_key = GetKey()) const {
+    return View().template EqualRangeWithin<SearchPolicy>(
+        data, bound, estimated_position, key, get_key);
+  }
+
+  // Returns the number of elements whose key equals `key`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  size_t Count(Iterator data, const KeyType key,
+               const GetKey& get_key = GetKey()) const {
+    return View().template Count<SearchPolicy>(data, key, get_key);
+  }
+
+  // Computes the search bounds of `num_keys` keys and stores them in `bounds`,
+  // and optionally the estimated positions in `estimates`. Overlaps the cache
+  // misses of independent keys, see `RadixSplineView::GetSearchBounds`.
+  void GetSearchBounds(const KeyType* keys, size_t num_keys,
+                       SearchBound* bounds,
+                       double* estimates = nullptr) const {
+    View().GetSearchBounds(keys, num_keys, bounds, estimates);
   }
 
   // Returns the size in bytes.
   size_t GetSize() const {
-    return sizeof(*this) + radix_table_.size() * sizeof(uint32_t) +
-           spline_points_.size() * sizeof(Coord<KeyType>);
+    return sizeof(*this) + radix_table_.GetSize() +
+           spline_keys_.size() * sizeof(KeyType) +
+           spline_positions_.size() * sizeof(double) +
+           spline_slopes_.size() * sizeof(double) + segment_errors_.size();
   }
 
  private:
-  // Returns the index of the spline point that marks the end of the spline
-  // segment that contains the `key`: `key` ∈ (spline[index - 1], spline[index]]
-  size_t GetSplineSegment(const KeyType key) const {
-    // Narrow search range using radix table.
-    const KeyType prefix = (key - min_key_) >> num_shift_bits_;
-    assert(prefix + 1 < radix_table_.size());
-    const uint32_t begin = radix_table_[prefix];
-    const uint32_t end = radix_table_[prefix + 1];
-
-    if (end - begin < 32) {
-      // Do linear search over narrowed range.
-      uint32_t current = begin;
-      while (spline_points_[current].x < key) ++current;
-      return current;
+  // Precomputes the slope of each spline segment, `spline_slopes_[index]`
+  // belongs to the segment that ends at `index`.
+  void ComputeSlopes() {
+    spline_slopes_.assign(spline_keys_.size(), 0);
+    for (size_t index = 1; index < spline_keys_.size(); ++index) {
+      const double x_diff = spline_keys_[index] - spline_keys_[index - 1];
+      const double y_diff =
+          spline_positions_[index] - spline_positions_[index - 1];
+      spline_slopes_[index] = y_diff / x_diff;
     }
-
-    // Do binary search over narrowed range.
-    const auto lb = std::lower_bound(
-        spline_points_.begin() + begin, spline_points_.begin() + end, key,
-        [](const Coord<KeyType>& coord, const KeyType key) {
-          return coord.x < key;
-        });
-    return std::distance(spline_points_.begin(), lb);
   }
 
   KeyType min_key_;
@@ -100,11 +202,22 @@ class RadixSpline {
   size_t num_shift_bits_;
   size_t max_error_;
 
-  std::vector<uint32_t> radix_table_;
-  std::vector<rs::Coord<KeyType>> spline_points_;
+  // All arrays start at a cache line boundary.
+  RadixTable radix_table_;
+  AlignedVector<KeyType> spline_keys_;
+  AlignedVector<double> spline_positions_;
+  // Empty unless the layout is `SplineLayout::kPrecomputedSlopes`.
+  AlignedVector<double> spline_slopes_;
+  // Empty unless the error bounds are `ErrorBounds::kPerSegment`.
+  AlignedVector<uint8_t> segment_errors_;
 
   template <typename>
   friend class Serializer;
+  template <typename>
+  friend class Tuner;
 };
 
+template <class KeyType>
+constexpr size_t RadixSpline<KeyType>::kBatchSize;
+
 }  // namespace rs
\ No newline at end of file
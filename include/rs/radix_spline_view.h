@@ -0,0 +1,487 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <utility>
+
+#include "common.h"
+#include "format.h"
+#include "instrumentation.h"
+#include "radix_table.h"
+#include "search.h"
+#include "simd_search.h"
+
+namespace rs {
+
+template <class KeyType>
+class RadixSpline;
+template <class KeyType>
+class Serializer;
+template <class KeyType, size_t kNumRadixBits, size_t kMaxError>
+class StaticRadixSpline;
+
+// Read-only `RadixSpline` over memory that is owned elsewhere. Either points
+// to the arrays of a `RadixSpline` or, without any deserialization, to a model
+// in the aligned format, e.g., in a memory-mapped file (see `FromBytes`).
+template <class KeyType>
+class RadixSplineView {
+ public:
+  // Number of lookups that `GetSearchBounds` interleaves.
+  static constexpr size_t kBatchSize = 16;
+
+  RadixSplineView() = default;
+
+  // `spline_slopes` may be null, slopes are then computed on each lookup.
+  // `segment_errors` may be null, all search bounds then use `max_error`.
+  RadixSplineView(KeyType min_key, KeyType max_key, size_t num_keys,
+                  size_t num_radix_bits, size_t num_shift_bits,
+                  size_t max_error, RadixTableView radix_table,
+                  const KeyType* spline_keys, const double* spline_positions,
+                  const double* spline_slopes, size_t num_spline_points,
+                  const uint8_t* segment_errors = nullptr)
+      : min_key_(min_key),
+        max_key_(max_key),
+        num_keys_(num_keys),
+        num_radix_bits_(num_radix_bits),
+        num_shift_bits_(num_shift_bits),
+        max_error_(max_error),
+        radix_table_(radix_table),
+        spline_keys_(spline_keys),
+        spline_positions_(spline_positions),
+        spline_slopes_(spline_slopes),
+        num_spline_points_(num_spline_points),
+        segment_errors_(segment_errors) {}
+
+  // Points `view` to the model in the aligned format at `data`, which needs to
+  // be 8-byte aligned and outlive the view. Returns false if `data` does not
+  // hold a valid model for `KeyType`. Verifying the checksum reads the entire
+  // model, `verify_checksum` = false skips it, e.g., for trusted files. Only
+  // the header and the bounds of the radix table are validated, so without
+  // the checksum `data` needs to come from `Serializer::ToAlignedBytes`. The
+  // checksum detects corruption, not tampering.
+  static bool FromBytes(const char* data, size_t size, RadixSplineView* view,
+                        bool verify_checksum = true) {
+    if (reinterpret_cast<uintptr_t>(data) % alignof(uint64_t) != 0)
+      return false;
+    if (size < sizeof(FormatHeader)) return false;
+    FormatHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != FormatHeader::kMagic ||
+        header.version < FormatHeader::kMinVersion ||
+        header.version > FormatHeader::kVersion ||
+        header.endianness_marker != FormatHeader::kEndiannessMarker ||
+        header.key_size != sizeof(KeyType))
+      return false;
+    if (header.spline_layout !=
+            static_cast<uint32_t>(SplineLayout::kCompact) &&
+        header.spline_layout !=
+            static_cast<uint32_t>(SplineLayout::kPrecomputedSlopes))
+      return false;
+    if (header.error_bounds != static_cast<uint32_t>(ErrorBounds::kGlobal) &&
+        (header.error_bounds !=
+             static_cast<uint32_t>(ErrorBounds::kPerSegment) ||
+         header.version < 3))
+      return false;
+    if (header.radix_table_delta_width != 0 &&
+        header.radix_table_delta_width != sizeof(uint8_t) &&
+        header.radix_table_delta_width != sizeof(uint16_t))
+      return false;
+    // Every element takes at least one byte, which also rules out overflows
+    // when computing the layout.
+    if (header.num_radix_table_entries < 2 ||
+        header.num_radix_table_entries > size ||
+        header.num_spline_points > size)
+      return false;
+    // All prefixes need to be covered by the radix table.
+    if (header.min_key > header.max_key ||
+        header.num_shift_bits >= sizeof(KeyType) * 8 ||
+        ((header.max_key - header.min_key) >> header.num_shift_bits) + 1 >=
+            header.num_radix_table_entries)
+      return false;
+    // Keys within (min_key, max_key) are interpolated between two spline
+    // points, the others are clamped to the first or the last position.
+    const bool interpolates =
+        header.num_keys > 0 && header.min_key < header.max_key;
+    if ((header.num_keys > 0 && header.num_spline_points < 1) ||
+        (interpolates && header.num_spline_points < 2))
+      return false;
+
+    const bool has_slopes =
+        header.spline_layout ==
+        static_cast<uint32_t>(SplineLayout::kPrecomputedSlopes);
+    const bool has_segment_errors =
+        header.error_bounds == static_cast<uint32_t>(ErrorBounds::kPerSegment);
+    const FormatLayout layout = FormatLayout::Compute(GetSectionSizes(
+        RadixTableView(nullptr, nullptr, header.num_radix_table_entries,
+                       header.radix_table_delta_width),
+        header.num_spline_points, has_slopes, has_segment_errors));
+    if (layout.total_size > size) return false;
+
+    const auto& offsets = layout.offsets;
+    *view = RadixSplineView(
+        header.min_key, header.max_key, header.num_keys, header.num_radix_bits,
+        header.num_shift_bits, header.max_error,
+        RadixTableView(
+            reinterpret_cast<const uint32_t*>(data +
+                                              offsets[kRadixTableEntries]),
+            reinterpret_cast<const uint8_t*>(data +
+                                             offsets[kRadixTableDeltas]),
+            header.num_radix_table_entries, header.radix_table_delta_width),
+        reinterpret_cast<const KeyType*>(data + offsets[kSplineKeys]),
+        reinterpret_cast<const double*>(data + offsets[kSplinePositions]),
+        has_slopes
+            ? reinterpret_cast<const double*>(data + offsets[kSplineSlopes])
+            : nullptr,
+        header.num_spline_points,
+        has_segment_errors
+            ? reinterpret_cast<const uint8_t*>(data + offsets[kSegmentErrors])
+            : nullptr);
+    // The radix table points to spline points, its largest and last entry
+    // may point one past the last one.
+    const RadixTableView& radix_table = view->radix_table_;
+    if (interpolates &&
+        radix_table[radix_table.size() - 1] > header.num_spline_points)
+      return false;
+    return !verify_checksum || view->ComputeChecksum(header) == header.checksum;
+  }
+
+  // Returns the estimated position of `key`.
+  double GetEstimatedPosition(const KeyType key) const {
+    // Truncate to data boundaries.
+    if (key <= min_key_ || key >= max_key_) {
+      RS_TRACE_LOOKUP(clamped, true);
+      return (key <= min_key_) ? 0 : num_keys_ - 1;
+    }
+
+    // Find spline segment with `key` ∈ (spline[index - 1], spline[index]].
+    const size_t index = GetSplineSegment(key);
+    return Interpolate(key, index);
+  }
+
+  // Returns a search bound [begin, end) around the estimated position. With
+  // per-segment errors, the bound extends by the errors of the segment of
+  // `key` instead of `max_error`, see `ErrorBounds`.
+  SearchBound GetSearchBound(const KeyType key) const {
+    double estimate;
+    return GetSearchBound(key, &estimate);
+  }
+
+  // Returns a search bound [begin, end) of `max_error` around
+  // `estimated_position`.
+  SearchBound GetSearchBoundAround(const double estimated_position) const {
+    const size_t estimate = estimated_position;
+    const size_t begin = (estimate < max_error_) ? 0 : (estimate - max_error_);
+    // `end` is exclusive.
+    const size_t end = (estimate + max_error_ + 2 > num_keys_)
+                           ? num_keys_
+                           : (estimate + max_error_ + 2);
+    return SearchBound{begin, end};
+  }
+
+  // Returns the position of the first element of `data` whose key is not
+  // smaller than `key`, or the number of keys if there is none. `data` needs
+  // to hold the keys that the spline was built on, `get_key` returns the key
+  // of an element. Searches within the bound around the estimated position
+  // with `SearchPolicy`, see search.h.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  size_t LowerBound(Iterator data, const KeyType key,
+                    const GetKey& get_key = GetKey()) const {
+    if (num_keys_ == 0) return 0;
+    double estimate;
+    const SearchBound bound = GetSearchBound(key, &estimate);
+    return LowerBoundWithin<SearchPolicy>(data, bound, estimate, key, get_key);
+  }
+
+  // Like `LowerBound`, but starts from a known `bound`, e.g., from
+  // `GetSearchBounds`, and `estimated_position` within it.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  size_t LowerBoundWithin(Iterator data, const SearchBound bound,
+                          const double estimated_position, const KeyType key,
+                          const GetKey& get_key = GetKey()) const {
+    const Iterator first = data + bound.begin;
+    const Iterator last = data + bound.end;
+    Iterator result = SearchPolicy::LowerBound(
+        first, last, data + static_cast<size_t>(estimated_position), key,
+        get_key);
+    RS_TRACE_LOOKUP(bound_width, bound.end - bound.begin);
+    // The error bound only holds for the first occurrence of each key. The
+    // result of a key that is not in the data, e.g., one that follows a long
+    // run of duplicates, can be outside of the bound.
+    if ((result == last && bound.end < num_keys_) ||
+        (result == first && bound.begin > 0)) {
+      RS_TRACE_LOOKUP(fallback, true);
+      result = ExponentialSearch::LowerBound(data, data + num_keys_, result,
+                                             key, get_key);
+    }
+    return result - data;
+  }
+
+  // Returns the range [first, second) of positions whose key equals `key`,
+  // see `LowerBound`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  std::pair<size_t, size_t> EqualRange(Iterator data, const KeyType key,
+                                       const GetKey& get_key = GetKey()) const {
+    if (num_keys_ == 0) return {0, 0};
+    double estimate;
+    const SearchBound bound = GetSearchBound(key, &estimate);
+    return EqualRangeWithin<SearchPolicy>(data, bound, estimate, key, get_key);
+  }
+
+  // Like `EqualRange`, but starts from a known `bound` and
+  // `estimated_position`, see `LowerBoundWithin`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  std::pair<size_t, size_t> EqualRangeWithin(
+      Iterator data, const SearchBound bound, const double estimated_position,
+      const KeyType key, const GetKey& get_key = GetKey()) const {
+    const size_t begin = LowerBoundWithin<SearchPolicy>(
+        data, bound, estimated_position, key, get_key);
+    // Duplicates may extend beyond the search bound, gallop over them. The
+    // keys in [begin, lo) are equal to `key`, the one at `hi` is larger.
+    size_t lo = begin;
+    size_t hi = begin;
+    for (size_t step = 1; hi < num_keys_ && !(key < get_key(data[hi]));
+         step *= 2) {
+      lo = hi + 1;
+      hi = begin + step;
+    }
+    hi = std::min(hi, num_keys_);
+    using Element = typename std::iterator_traits<Iterator>::value_type;
+    const size_t end = std::upper_bound(data + lo, data + hi, key,
+                                        [&](const KeyType& k,
+                                            const Element& element) {
+                                          return k < get_key(element);
+                                        }) -
+                       data;
+    RS_TRACE_LOOKUP(equal_range_size, end - begin);
+    return {begin, end};
+  }
+
+  // Returns the number of elements whose key equals `key`, see `LowerBound`.
+  template <class SearchPolicy = ExponentialSearch, class Iterator,
+            class GetKey = KeyIdentity>
+  size_t Count(Iterator data, const KeyType key,
+               const GetKey& get_key = GetKey()) const {
+    const std::pair<size_t, size_t> range =
+        EqualRange<SearchPolicy>(data, key, get_key);
+    return range.second - range.first;
+  }
+
+  // Computes the search bounds of `num_keys` keys and stores them in `bounds`,
+  // and the estimated positions in `estimates` unless it is null. Bounds are
+  // not centered on the estimates if they are clamped or per-segment.
+  // Processes the keys in groups of `kBatchSize` and runs each step for the
+  // entire group before moving on to the next one. The loads of each step are
+  // prefetched, so that the cache misses of independent keys overlap.
+  void GetSearchBounds(const KeyType* keys, size_t num_keys,
+                       SearchBound* bounds,
+                       double* estimates = nullptr) const {
+    size_t prefixes[kBatchSize];
+    uint32_t begins[kBatchSize];
+    for (size_t offset = 0; offset < num_keys; offset += kBatchSize) {
+      const size_t batch_size = std::min(kBatchSize, num_keys - offset);
+      const KeyType* batch_keys = keys + offset;
+
+      // Compute the prefixes and prefetch the radix table entries.
+      for (size_t i = 0; i < batch_size; ++i) {
+        prefixes[i] = IsInRange(batch_keys[i]) ? GetPrefix(batch_keys[i]) : 0;
+        radix_table_.Prefetch(prefixes[i]);
+      }
+
+      // Load the radix table entries and prefetch the spline points.
+      for (size_t i = 0; i < batch_size; ++i) {
+        begins[i] = radix_table_[prefixes[i]];
+        __builtin_prefetch(spline_keys_ + begins[i]);
+        if (segment_errors_ != nullptr)
+          __builtin_prefetch(segment_errors_ + 2 * begins[i]);
+      }
+
+      // Search the spline segments and interpolate.
+      for (size_t i = 0; i < batch_size; ++i) {
+        const KeyType key = batch_keys[i];
+        double estimate;
+        if (key <= min_key_) {
+          estimate = 0;
+          bounds[offset + i] = GetSearchBoundAround(estimate);
+        } else if (key >= max_key_) {
+          estimate = num_keys_ - 1;
+          bounds[offset + i] = GetSearchBoundAround(estimate);
+        } else {
+          const uint32_t end = radix_table_[prefixes[i] + 1];
+          const size_t index = SearchSplineSegment(key, begins[i], end);
+          estimate = Interpolate(key, index);
+          bounds[offset + i] = GetSegmentSearchBound(estimate, index);
+        }
+        if (estimates != nullptr) estimates[offset + i] = estimate;
+      }
+    }
+  }
+
+  // Returns the size in bytes, including the referenced arrays.
+  size_t GetSize() const {
+    return sizeof(*this) + radix_table_.GetSize() +
+           num_spline_points_ * sizeof(KeyType) +
+           num_spline_points_ * sizeof(double) +
+           (spline_slopes_ ? num_spline_points_ * sizeof(double) : 0) +
+           (segment_errors_ ? 2 * num_spline_points_ : 0);
+  }
+
+ private:
+  // Returns the sizes in bytes of the arrays in the aligned format.
+  static FormatSectionSizes GetSectionSizes(const RadixTableView& radix_table,
+                                            size_t num_spline_points,
+                                            bool has_slopes,
+                                            bool has_segment_errors) {
+    FormatSectionSizes sizes;
+    sizes[kRadixTableEntries] =
+        radix_table.num_stored_entries() * sizeof(uint32_t);
+    sizes[kRadixTableDeltas] = radix_table.size() * radix_table.delta_width();
+    sizes[kSplineKeys] = num_spline_points * sizeof(KeyType);
+    sizes[kSplinePositions] = num_spline_points * sizeof(double);
+    sizes[kSplineSlopes] = has_slopes ? num_spline_points * sizeof(double) : 0;
+    sizes[kSegmentErrors] = has_segment_errors ? 2 * num_spline_points : 0;
+    return sizes;
+  }
+  FormatSectionSizes GetSectionSizes() const {
+    return GetSectionSizes(radix_table_, num_spline_points_,
+                           spline_slopes_ != nullptr,
+                           segment_errors_ != nullptr);
+  }
+
+  // Returns the arrays in the order of the aligned format.
+  std::array<const void*, kNumFormatSections> GetSectionData() const {
+    return {{radix_table_.entries(), radix_table_.deltas(), spline_keys_,
+             spline_positions_, spline_slopes_, segment_errors_}};
+  }
+
+  // Returns the checksum of `header` and the arrays of this view.
+  uint64_t ComputeChecksum(FormatHeader header) const {
+    header.checksum = 0;
+    uint64_t checksum = Hash64(&header, sizeof(header), /*seed=*/0);
+    const FormatSectionSizes sizes = GetSectionSizes();
+    const auto data = GetSectionData();
+    for (size_t i = 0; i < kNumFormatSections; ++i) {
+      // Models without segment errors keep the checksum of version 2.
+      if (i == kSegmentErrors && segment_errors_ == nullptr) continue;
+      checksum = Hash64(data[i], sizes[i], /*seed=*/checksum);
+    }
+    return checksum;
+  }
+
+  // Returns true if `key` lies strictly between the smallest and the largest
+  // key, i.e., if it needs to be looked up on the spline.
+  bool IsInRange(const KeyType key) const {
+    return key > min_key_ && key < max_key_;
+  }
+
+  // Returns the radix table prefix of `key`.
+  size_t GetPrefix(const KeyType key) const {
+    return (key - min_key_) >> num_shift_bits_;
+  }
+
+  // Returns the search bound of `key` and stores its estimated position in
+  // `estimated_position`.
+  SearchBound GetSearchBound(const KeyType key,
+                             double* estimated_position) const {
+    if (segment_errors_ == nullptr || !IsInRange(key)) {
+      *estimated_position = GetEstimatedPosition(key);
+      return GetSearchBoundAround(*estimated_position);
+    }
+    const size_t index = GetSplineSegment(key);
+    *estimated_position = Interpolate(key, index);
+    return GetSegmentSearchBound(*estimated_position, index);
+  }
+
+  // Returns the search bound around `estimated_position` on the segment that
+  // ends at `index`, with the errors of the segment if there are any.
+  SearchBound GetSegmentSearchBound(const double estimated_position,
+                                    const size_t index) const {
+    if (segment_errors_ == nullptr)
+      return GetSearchBoundAround(estimated_position);
+    const size_t unit = GetSegmentErrorUnit(max_error_);
+    const size_t below = segment_errors_[2 * index] * unit;
+    const size_t above = segment_errors_[2 * index + 1] * unit;
+    const size_t estimate = estimated_position;
+    const size_t begin = (estimate < below) ? 0 : (estimate - below);
+    const size_t end = std::min(estimate + above + 2, num_keys_);
+    return SearchBound{begin, end};
+  }
+
+  // Returns the index of the spline point that marks the end of the spline
+  // segment that contains the `key`: `key` ∈ (spline[index - 1], spline[index]]
+  size_t GetSplineSegment(const KeyType key) const {
+    // Narrow search range using radix table.
+    const KeyType prefix = GetPrefix(key);
+    assert(prefix + 1 < radix_table_.size());
+    const uint32_t begin = radix_table_[prefix];
+    const uint32_t end = radix_table_[prefix + 1];
+    return SearchSplineSegment(key, begin, end);
+  }
+
+  // Returns the index of the spline segment of `key` within the narrowed range
+  // [begin, end] given by the radix table.
+  size_t SearchSplineSegment(const KeyType key, const uint32_t begin,
+                             const uint32_t end) const {
+    // Small ranges are scanned linearly, larger ones are binary searched.
+    RS_TRACE_LOOKUP(segment_range, end - begin);
+    RS_TRACE_LOOKUP(binary_segment_search,
+                    end - begin > simd::kLinearSearchThreshold);
+    return begin + simd::LowerBound(spline_keys_ + begin, end - begin, key);
+  }
+
+  // Interpolates the position of `key` on the spline segment ending at
+  // `index`.
+  double Interpolate(const KeyType key, const size_t index) const {
+    const KeyType down_x = spline_keys_[index - 1];
+    const double down_y = spline_positions_[index - 1];
+    const double key_diff = key - down_x;
+
+    // Use the precomputed slope if available.
+    if (spline_slopes_ != nullptr)
+      return std::fma(key_diff, spline_slopes_[index], down_y);
+
+    // Compute slope.
+    const double x_diff = spline_keys_[index] - down_x;
+    const double y_diff = spline_positions_[index] - down_y;
+    const double slope = y_diff / x_diff;
+
+    // Interpolate.
+    return std::fma(key_diff, slope, down_y);
+  }
+
+  KeyType min_key_;
+  KeyType max_key_;
+  size_t num_keys_;
+  size_t num_radix_bits_;
+  size_t num_shift_bits_;
+  size_t max_error_;
+
+  RadixTableView radix_table_;
+  const KeyType* spline_keys_;
+  const double* spline_positions_;
+  // Null unless the layout is `SplineLayout::kPrecomputedSlopes`.
+  const double* spline_slopes_;
+  size_t num_spline_points_;
+  // Null unless the error bounds are `ErrorBounds::kPerSegment`. The errors
+  // below and above the estimates of the segment ending at each spline point.
+  const uint8_t* segment_errors_ = nullptr;
+
+  template <typename>
+  friend class RadixSpline;
+  template <typename>
+  friend class Serializer;
+  template <typename, size_t, size_t>
+  friend class StaticRadixSpline;
+};
+
+template <class KeyType>
+constexpr size_t RadixSplineView<KeyType>::kBatchSize;
+
+}  // namespace rs
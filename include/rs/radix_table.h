@@ -0,0 +1,173 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "allocator.h"
+#include "common.h"
+
+namespace rs {
+
+// Read-only access to the entries of a radix table that is stored elsewhere,
+// e.g., in a `RadixTable` or in a memory-mapped file.
+class RadixTableView {
+ public:
+  // Number of entries that share a base in the compressed encoding.
+  static constexpr size_t kBlockSize = 64;
+
+  RadixTableView() = default;
+
+  // `entries` holds the entries (plain) or the base of each block
+  // (compressed), `deltas` the `delta_width`-byte delta of each entry to the
+  // base of its block. A `delta_width` of 0 denotes the plain encoding.
+  RadixTableView(const uint32_t* entries, const uint8_t* deltas,
+                 size_t num_entries, size_t delta_width)
+      : entries_(entries),
+        deltas_(deltas),
+        num_entries_(num_entries),
+        delta_width_(delta_width) {}
+
+  // Returns the entry at `index`.
+  uint32_t operator[](size_t index) const {
+    assert(index < num_entries_);
+    if (delta_width_ == 0) return entries_[index];
+    const uint32_t base = entries_[index / kBlockSize];
+    if (delta_width_ == sizeof(uint8_t)) return base + deltas_[index];
+    uint16_t delta;
+    std::memcpy(&delta, deltas_ + index * sizeof(uint16_t), sizeof(delta));
+    return base + delta;
+  }
+
+  // Prefetches the entry at `index`. The bases of the compressed encoding are
+  // small enough to stay cached.
+  void Prefetch(size_t index) const {
+    if (delta_width_ == 0) {
+      __builtin_prefetch(entries_ + index);
+    } else {
+      __builtin_prefetch(deltas_ + index * delta_width_);
+    }
+  }
+
+  // Returns the number of entries.
+  size_t size() const { return num_entries_; }
+
+  // Returns the encoding that is actually used.
+  RadixTableEncoding encoding() const {
+    return (delta_width_ == 0) ? RadixTableEncoding::kPlain
+                               : RadixTableEncoding::kCompressed;
+  }
+
+  // Returns the size of a delta in bytes, 0 for the plain encoding.
+  size_t delta_width() const { return delta_width_; }
+
+  // Returns the number of stored `uint32_t` values: entries (plain) or bases
+  // (compressed).
+  size_t num_stored_entries() const {
+    return (delta_width_ == 0) ? num_entries_
+                               : (num_entries_ + kBlockSize - 1) / kBlockSize;
+  }
+
+  const uint32_t* entries() const { return entries_; }
+  const uint8_t* deltas() const { return deltas_; }
+
+  // Returns the size of the encoded entries in bytes.
+  size_t GetSize() const {
+    return num_stored_entries() * sizeof(uint32_t) +
+           num_entries_ * delta_width_;
+  }
+
+ private:
+  const uint32_t* entries_ = nullptr;
+  const uint8_t* deltas_ = nullptr;
+  size_t num_entries_ = 0;
+  size_t delta_width_ = 0;
+};
+
+// Maps radix prefixes to spline point indexes. The entries are monotonically
+// increasing and typically contain long runs of the same value, which
+// `RadixTableEncoding::kCompressed` exploits.
+class RadixTable {
+ public:
+  static constexpr size_t kBlockSize = RadixTableView::kBlockSize;
+
+  RadixTable() = default;
+
+  // Encodes the monotonically increasing `entries`. The encoded arrays use
+  // the allocator of `entries`.
+  RadixTable(AlignedVector<uint32_t> entries, RadixTableEncoding encoding)
+      : num_entries_(entries.size()),
+        delta_width_(0),
+        entries_(entries.get_allocator()),
+        deltas_(entries.get_allocator()) {
+    if (encoding == RadixTableEncoding::kPlain) {
+      entries_ = std::move(entries);
+      return;
+    }
+
+    // Determine the largest delta within a block.
+    uint32_t max_delta = 0;
+    for (size_t begin = 0; begin < entries.size(); begin += kBlockSize) {
+      const size_t last = std::min(begin + kBlockSize, entries.size()) - 1;
+      assert(entries[last] >= entries[begin]);
+      max_delta = std::max(max_delta, entries[last] - entries[begin]);
+    }
+    if (max_delta > UINT16_MAX) {
+      // Deltas don't fit into 16 bits, keep the plain encoding.
+      entries_ = std::move(entries);
+      return;
+    }
+    delta_width_ = (max_delta > UINT8_MAX) ? sizeof(uint16_t) : sizeof(uint8_t);
+
+    // Store a base per block and a delta per entry.
+    entries_.reserve((entries.size() + kBlockSize - 1) / kBlockSize);
+    deltas_.resize(entries.size() * delta_width_);
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (i % kBlockSize == 0) entries_.push_back(entries[i]);
+      const uint32_t delta = entries[i] - entries_.back();
+      if (delta_width_ == sizeof(uint8_t)) {
+        deltas_[i] = delta;
+      } else {
+        const uint16_t delta16 = delta;
+        std::memcpy(&deltas_[i * sizeof(uint16_t)], &delta16, sizeof(delta16));
+      }
+    }
+  }
+
+  // Copies the table that `view` points to.
+  explicit RadixTable(const RadixTableView& view)
+      : num_entries_(view.size()),
+        delta_width_(view.delta_width()),
+        entries_(view.entries(), view.entries() + view.num_stored_entries()),
+        deltas_(view.deltas(),
+                view.deltas() + view.size() * view.delta_width()) {}
+
+  RadixTableView View() const {
+    return RadixTableView(entries_.data(), deltas_.data(), num_entries_,
+                          delta_width_);
+  }
+
+  // Returns the entry at `index`.
+  uint32_t operator[](size_t index) const { return View()[index]; }
+
+  // Returns the number of entries.
+  size_t size() const { return num_entries_; }
+
+  // Returns the encoding that is actually used.
+  RadixTableEncoding encoding() const { return View().encoding(); }
+
+  // Returns the size of the encoded entries in bytes.
+  size_t GetSize() const { return View().GetSize(); }
+
+ private:
+  size_t num_entries_ = 0;
+  // Size of a delta in bytes, 0 for the plain encoding.
+  size_t delta_width_ = 0;
+
+  // The entries (plain) or the base of each block (compressed).
+  AlignedVector<uint32_t> entries_;
+  // The 8- or 16-bit delta of each entry to the base of its block.
+  AlignedVector<uint8_t> deltas_;
+};
+
+}  // namespace rs
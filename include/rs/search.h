@@ -0,0 +1,134 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
+#include "simd_search.h"
+
+namespace rs {
+
+// Last-mile search policies. Each policy has a static
+//
+//   Iterator LowerBound(Iterator begin, Iterator end, Iterator estimate,
+//                       KeyType key, GetKey get_key)
+//
+// that returns the first element in the sorted range [begin, end) whose key
+// `get_key(element)` is not smaller than `key`, or `end` if there is none.
+// `estimate` is the estimated position in [begin, end), e.g., from
+// `RadixSpline::GetEstimatedPosition`, and only affects the performance.
+
+// Returns the element itself, which lets `LinearSearch` scan plain key arrays
+// with SIMD instructions.
+struct KeyIdentity {
+  template <class T>
+  const T& operator()(const T& element) const {
+    return element;
+  }
+};
+
+// `std::lower_bound` over the entire range.
+struct BinarySearch {
+  template <class Iterator, class KeyType, class GetKey>
+  static Iterator LowerBound(Iterator begin, Iterator end, Iterator,
+                             KeyType key, const GetKey& get_key) {
+    using Element = typename std::iterator_traits<Iterator>::value_type;
+    return std::lower_bound(begin, end, key,
+                            [&](const Element& element, const KeyType& k) {
+                              return get_key(element) < k;
+                            });
+  }
+};
+
+// Binary search without data-dependent branches, i.e., with conditional moves
+// instead of branch mispredictions.
+struct BranchlessBinarySearch {
+  template <class Iterator, class KeyType, class GetKey>
+  static Iterator LowerBound(Iterator begin, Iterator end, Iterator,
+                             KeyType key, const GetKey& get_key) {
+    size_t size = end - begin;
+    if (size == 0) return begin;
+    Iterator base = begin;
+    while (size > 1) {
+      const size_t half = size / 2;
+      base = (get_key(base[half]) < key) ? base + half : base;
+      size -= half;
+    }
+    return base + (get_key(*base) < key);
+  }
+};
+
+// Exponential search outward from the estimated position, followed by a
+// binary search in the last step. Touches O(log d) elements for a distance d
+// between the estimate and the result, i.e., few for accurate estimates.
+struct ExponentialSearch {
+  template <class Iterator, class KeyType, class GetKey>
+  static Iterator LowerBound(Iterator begin, Iterator end, Iterator estimate,
+                             KeyType key, const GetKey& get_key) {
+    if (begin == end) return begin;
+    const size_t size = end - begin;
+    const size_t position = std::min<size_t>(estimate - begin, size - 1);
+
+    size_t lo, hi;
+    size_t bound = 1;
+    if (get_key(begin[position]) < key) {
+      // The result is to the right of `position`.
+      while (position + bound < size && get_key(begin[position + bound]) < key)
+        bound *= 2;
+      lo = position + bound / 2 + 1;
+      hi = std::min(position + bound, size);
+    } else {
+      // The result is `position` or to the left of it.
+      while (bound <= position && !(get_key(begin[position - bound]) < key))
+        bound *= 2;
+      lo = (bound <= position) ? position - bound + 1 : 0;
+      hi = position - bound / 2 + 1;
+    }
+    return BinarySearch::LowerBound(begin + lo, begin + hi, begin + lo, key,
+                                    get_key);
+  }
+};
+
+// Counts the smaller keys of small ranges in a single pass, with SIMD
+// instructions for plain `uint32_t` and `uint64_t` key arrays. Ranges with
+// more than `kMaxSize` elements fall back to `BranchlessBinarySearch`.
+struct LinearSearch {
+  static constexpr size_t kMaxSize = 64;
+
+  template <class Iterator, class KeyType, class GetKey>
+  static Iterator LowerBound(Iterator begin, Iterator end, Iterator estimate,
+                             KeyType key, const GetKey& get_key) {
+    const size_t size = end - begin;
+    if (size == 0) return begin;
+    if (size > kMaxSize) {
+      return BranchlessBinarySearch::LowerBound(begin, end, estimate, key,
+                                                get_key);
+    }
+    return begin + CountLess(begin, size, key, get_key);
+  }
+
+ private:
+  // Returns the number of elements in [begin, begin + size) whose key is
+  // smaller than `key`. Has no data-dependent branches.
+  template <class Iterator, class KeyType, class GetKey>
+  static size_t CountLess(Iterator begin, size_t size, KeyType key,
+                          const GetKey& get_key) {
+    size_t count = 0;
+    for (size_t i = 0; i < size; ++i) count += get_key(begin[i]) < key;
+    return count;
+  }
+  // Plain key arrays.
+  template <class Iterator>
+  static size_t CountLess(Iterator begin, size_t size, uint32_t key,
+                          const KeyIdentity&) {
+    return simd::CountLess(&*begin, size, key);
+  }
+  template <class Iterator>
+  static size_t CountLess(Iterator begin, size_t size, uint64_t key,
+                          const KeyIdentity&) {
+    return simd::CountLess(&*begin, size, key);
+  }
+};
+
+}  // namespace rs
@@ -1,7 +1,17 @@
 #pragma once
 
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
 #include <sstream>
+#include <string>
+#include <vector>
 
+#include "format.h"
 #include "radix_spline.h"
 
 namespace rs {
@@ -9,44 +19,132 @@ namespace rs {
 template <class KeyType>
 class Serializer {
  public:
-  // Serializes the `rs` model and appends it to `bytes`.
-  static void ToBytes(const RadixSpline<KeyType>& rs, std::string* bytes) {
-    std::stringstream buffer;
+  // Serializes the `rs` model and appends it to `bytes`. The format has no
+  // per-segment errors, so this returns false and leaves `bytes` unchanged for
+  // models with `ErrorBounds::kPerSegment`, which need `ToAlignedBytes`.
+  static bool ToBytes(const RadixSpline<KeyType>& rs, std::string* bytes) {
+    if (!rs.segment_errors_.empty()) return false;
+    const size_t radix_table_size = rs.radix_table_.size();
+    const size_t spline_points_size = rs.spline_keys_.size();
+
+    // Write straight into `bytes`, which is resized once.
+    const size_t offset = bytes->size();
+    bytes->resize(offset + 2 * sizeof(KeyType) + 6 * sizeof(size_t) +
+                  radix_table_size * sizeof(uint32_t) +
+                  spline_points_size * (sizeof(KeyType) + sizeof(double)));
+    char* out = &(*bytes)[offset];
 
     // Scalar members.
-    buffer.write(reinterpret_cast<const char*>(&rs.min_key_), sizeof(KeyType));
-    buffer.write(reinterpret_cast<const char*>(&rs.max_key_), sizeof(KeyType));
-    buffer.write(reinterpret_cast<const char*>(&rs.num_keys_), sizeof(size_t));
-    buffer.write(reinterpret_cast<const char*>(&rs.num_radix_bits_),
-                 sizeof(size_t));
-    buffer.write(reinterpret_cast<const char*>(&rs.num_shift_bits_),
-                 sizeof(size_t));
-    buffer.write(reinterpret_cast<const char*>(&rs.max_error_), sizeof(size_t));
+    out = Append(out, &rs.min_key_, sizeof(KeyType));
+    out = Append(out, &rs.max_key_, sizeof(KeyType));
+    out = Append(out, &rs.num_keys_, sizeof(size_t));
+    out = Append(out, &rs.num_radix_bits_, sizeof(size_t));
+    out = Append(out, &rs.num_shift_bits_, sizeof(size_t));
+    out = Append(out, &rs.max_error_, sizeof(size_t));
 
-    // Radix table.
-    const size_t radix_table_size = rs.radix_table_.size();
-    buffer.write(reinterpret_cast<const char*>(&radix_table_size),
-                 sizeof(size_t));
-    for (size_t i = 0; i < rs.radix_table_.size(); ++i) {
-      buffer.write(reinterpret_cast<const char*>(&rs.radix_table_[i]),
-                   sizeof(uint32_t));
+    // Radix table, always stored in the plain encoding.
+    out = Append(out, &radix_table_size, sizeof(size_t));
+    const RadixTableView radix_table = rs.radix_table_.View();
+    if (radix_table.encoding() == RadixTableEncoding::kPlain) {
+      out = Append(out, radix_table.entries(),
+                   radix_table_size * sizeof(uint32_t));
+    } else {
+      for (size_t i = 0; i < radix_table_size; ++i) {
+        const uint32_t entry = radix_table[i];
+        out = Append(out, &entry, sizeof(uint32_t));
+      }
     }
 
     // Spline points.
-    const size_t spline_points_size = rs.spline_points_.size();
-    buffer.write(reinterpret_cast<const char*>(&spline_points_size),
-                 sizeof(size_t));
-    for (size_t i = 0; i < rs.spline_points_.size(); ++i) {
-      buffer.write(reinterpret_cast<const char*>(&rs.spline_points_[i].x),
-                   sizeof(KeyType));
-      buffer.write(reinterpret_cast<const char*>(&rs.spline_points_[i].y),
-                   sizeof(double));
+    out = Append(out, &spline_points_size, sizeof(size_t));
+    for (size_t i = 0; i < spline_points_size; ++i) {
+      out = Append(out, &rs.spline_keys_[i], sizeof(KeyType));
+      out = Append(out, &rs.spline_positions_[i], sizeof(double));
+    }
+    return true;
+  }
+
+  // Returns the size of the `rs` model in the aligned format.
+  static size_t GetAlignedSize(const RadixSpline<KeyType>& rs) {
+    return FormatLayout::Compute(rs.View().GetSectionSizes()).total_size;
+  }
+
+  // Serializes the `rs` model in the aligned format into `buffer`, which needs
+  // to hold `GetAlignedSize(rs)` bytes. Copies every section with a single
+  // `memcpy`.
+  static void ToAlignedBuffer(const RadixSpline<KeyType>& rs, char* buffer) {
+    const RadixSplineView<KeyType> view = rs.View();
+    const FormatHeader header = CreateHeader(view);
+    const FormatSectionSizes sizes = view.GetSectionSizes();
+    const FormatLayout layout = FormatLayout::Compute(sizes);
+    const auto data = view.GetSectionData();
+
+    // Zero the padding, so that the output is deterministic.
+    std::memset(buffer, 0, layout.total_size);
+    std::memcpy(buffer, &header, sizeof(header));
+    for (size_t i = 0; i < kNumFormatSections; ++i) {
+      if (sizes[i] > 0)
+        std::memcpy(buffer + layout.offsets[i], data[i], sizes[i]);
     }
+  }
 
-    bytes->append(buffer.str());
+  // Serializes the `rs` model in the aligned format and appends it to `bytes`.
+  // `RadixSplineView::FromBytes` reads the result in place, provided that it
+  // starts at an 8-byte aligned address, e.g., at the beginning of a file.
+  static void ToAlignedBytes(const RadixSpline<KeyType>& rs,
+                             std::string* bytes) {
+    const size_t offset = bytes->size();
+    bytes->resize(offset + GetAlignedSize(rs));
+    ToAlignedBuffer(rs, &(*bytes)[offset]);
   }
 
-  static RadixSpline<KeyType> FromBytes(const std::string& bytes) {
+  // Writes the `rs` model in the aligned format to the file descriptor `fd`,
+  // straight from the model's arrays with a single `writev` call (unless the
+  // kernel writes partially). Returns false on write errors.
+  static bool WriteAligned(const RadixSpline<KeyType>& rs, int fd) {
+    const RadixSplineView<KeyType> view = rs.View();
+    const FormatHeader header = CreateHeader(view);
+    const FormatSectionSizes sizes = view.GetSectionSizes();
+    const FormatLayout layout = FormatLayout::Compute(sizes);
+    const auto data = view.GetSectionData();
+
+    // The header is padded up to the first section.
+    std::vector<char> header_block(layout.offsets[0], 0);
+    std::memcpy(header_block.data(), &header, sizeof(header));
+    static const char kPadding[kFormatAlignment] = {};
+
+    std::vector<iovec> parts;
+    parts.push_back({header_block.data(), header_block.size()});
+    for (size_t i = 0; i < kNumFormatSections; ++i) {
+      if (sizes[i] > 0) parts.push_back({const_cast<void*>(data[i]), sizes[i]});
+      const size_t next_offset = (i + 1 < kNumFormatSections)
+                                     ? layout.offsets[i + 1]
+                                     : layout.total_size;
+      const size_t padding = next_offset - layout.offsets[i] - sizes[i];
+      if (padding > 0) parts.push_back({const_cast<char*>(kPadding), padding});
+    }
+    return WriteAll(fd, parts.data(), parts.size());
+  }
+
+  // Copies the model in the aligned format at `data` into `rs`. Returns false
+  // if `data` does not hold a valid model, including checksum mismatches.
+  static bool FromAlignedBytes(const char* data, size_t size,
+                               RadixSpline<KeyType>* rs) {
+    RadixSplineView<KeyType> view;
+    if (!RadixSplineView<KeyType>::FromBytes(data, size, &view)) return false;
+    *rs = RadixSpline<KeyType>(view);
+    return true;
+  }
+
+  // Deserializes a model from `bytes`. The serialized format does not contain
+  // slopes and stores the radix table in the plain encoding, they are
+  // recomputed and re-encoded according to `spline_layout` and
+  // `radix_table_encoding`. Per-segment errors are not serialized, the model
+  // uses `ErrorBounds::kGlobal`.
+  static RadixSpline<KeyType> FromBytes(
+      const std::string& bytes,
+      SplineLayout spline_layout = SplineLayout::kCompact,
+      RadixTableEncoding radix_table_encoding = RadixTableEncoding::kPlain) {
     std::istringstream in(bytes);
 
     RadixSpline<KeyType> rs;
@@ -62,23 +160,83 @@ class Serializer {
     // Radix table.
     size_t radix_table_size;
     in.read(reinterpret_cast<char*>(&radix_table_size), sizeof(size_t));
-    rs.radix_table_.resize(radix_table_size);
-    for (int i = 0; i < rs.radix_table_.size(); ++i) {
-      in.read(reinterpret_cast<char*>(&rs.radix_table_[i]), sizeof(uint32_t));
-    }
+    AlignedVector<uint32_t> radix_table(radix_table_size);
+    in.read(reinterpret_cast<char*>(radix_table.data()),
+            radix_table_size * sizeof(uint32_t));
+    rs.radix_table_ = RadixTable(std::move(radix_table), radix_table_encoding);
 
     // Spline points.
     size_t spline_points_size;
     in.read(reinterpret_cast<char*>(&spline_points_size), sizeof(size_t));
-    rs.spline_points_.resize(spline_points_size);
-    for (int i = 0; i < rs.spline_points_.size(); ++i) {
-      in.read(reinterpret_cast<char*>(&rs.spline_points_[i].x),
-              sizeof(KeyType));
-      in.read(reinterpret_cast<char*>(&rs.spline_points_[i].y), sizeof(double));
+    rs.spline_keys_.resize(spline_points_size);
+    rs.spline_positions_.resize(spline_points_size);
+    for (size_t i = 0; i < spline_points_size; ++i) {
+      in.read(reinterpret_cast<char*>(&rs.spline_keys_[i]), sizeof(KeyType));
+      in.read(reinterpret_cast<char*>(&rs.spline_positions_[i]),
+              sizeof(double));
     }
+    if (spline_layout == SplineLayout::kPrecomputedSlopes) rs.ComputeSlopes();
 
     return rs;
   }
+
+ private:
+  // Copies `size` bytes to `out` and returns the end of the copy.
+  static char* Append(char* out, const void* source, size_t size) {
+    if (size > 0) std::memcpy(out, source, size);
+    return out + size;
+  }
+
+  // Returns the header of the aligned format for `view`, including the
+  // checksum.
+  static FormatHeader CreateHeader(const RadixSplineView<KeyType>& view) {
+    FormatHeader header;
+    std::memset(&header, 0, sizeof(header));
+    header.magic = FormatHeader::kMagic;
+    header.version = FormatHeader::kVersion;
+    header.endianness_marker = FormatHeader::kEndiannessMarker;
+    header.key_size = sizeof(KeyType);
+    header.spline_layout = static_cast<uint32_t>(
+        view.spline_slopes_ ? SplineLayout::kPrecomputedSlopes
+                            : SplineLayout::kCompact);
+    header.radix_table_delta_width = view.radix_table_.delta_width();
+    header.error_bounds = static_cast<uint32_t>(
+        view.segment_errors_ ? ErrorBounds::kPerSegment : ErrorBounds::kGlobal);
+    header.min_key = view.min_key_;
+    header.max_key = view.max_key_;
+    header.num_keys = view.num_keys_;
+    header.num_radix_bits = view.num_radix_bits_;
+    header.num_shift_bits = view.num_shift_bits_;
+    header.max_error = view.max_error_;
+    header.num_radix_table_entries = view.radix_table_.size();
+    header.num_spline_points = view.num_spline_points_;
+    header.checksum = view.ComputeChecksum(header);
+    return header;
+  }
+
+  // Writes all `parts` to `fd`, retries after partial writes and interrupts.
+  static bool WriteAll(int fd, iovec* parts, size_t num_parts) {
+    while (num_parts > 0) {
+      const size_t batch = std::min<size_t>(num_parts, IOV_MAX);
+      const ssize_t written = writev(fd, parts, batch);
+      if (written < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      // Skip the parts that were written entirely.
+      size_t remaining = written;
+      while (num_parts > 0 && remaining >= parts->iov_len) {
+        remaining -= parts->iov_len;
+        ++parts;
+        --num_parts;
+      }
+      if (num_parts > 0) {
+        parts->iov_base = static_cast<char*>(parts->iov_base) + remaining;
+        parts->iov_len -= remaining;
+      }
+    }
+    return true;
+  }
 };
 
 }  // namespace rs
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace rs {
+namespace simd {
+
+// Search kernels over sorted, dense key arrays. The instruction set is picked
+// at compile time: AVX-512 compares 8 (`uint64_t`) or 16 (`uint32_t`) keys per
+// instruction, AVX2 4 or 8 keys, and the scalar fallback one key.
+
+// Returns the number of keys in [keys, keys + size) that are smaller than
+// `key`. Assumes that the keys are sorted and stops at the first vector that
+// contains a key that is not smaller than `key`.
+inline size_t CountLess(const uint32_t* keys, size_t size, uint32_t key) {
+  size_t i = 0;
+#if defined(__AVX512F__)
+  const __m512i needle = _mm512_set1_epi32(key);
+  for (; i + 16 <= size; i += 16) {
+    const __m512i values = _mm512_loadu_si512(keys + i);
+    const __mmask16 less = _mm512_cmplt_epu32_mask(values, needle);
+    if (less != 0xFFFF) return i + __builtin_popcount(less);
+  }
+  if (i < size) {
+    const __mmask16 valid = (1u << (size - i)) - 1;
+    const __m512i values = _mm512_maskz_loadu_epi32(valid, keys + i);
+    i += __builtin_popcount(_mm512_mask_cmplt_epu32_mask(valid, values, needle));
+  }
+  return i;
+#elif defined(__AVX2__)
+  // AVX2 only has signed comparisons, hence flip the sign bits.
+  const __m256i sign = _mm256_set1_epi32(INT32_MIN);
+  const __m256i needle = _mm256_xor_si256(_mm256_set1_epi32(key), sign);
+  for (; i + 8 <= size; i += 8) {
+    const __m256i values = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), sign);
+    const int less = _mm256_movemask_ps(
+        _mm256_castsi256_ps(_mm256_cmpgt_epi32(needle, values)));
+    if (less != 0xFF) return i + __builtin_popcount(less);
+  }
+#endif
+  while (i < size && keys[i] < key) ++i;
+  return i;
+}
+
+inline size_t CountLess(const uint64_t* keys, size_t size, uint64_t key) {
+  size_t i = 0;
+#if defined(__AVX512F__)
+  const __m512i needle = _mm512_set1_epi64(key);
+  for (; i + 8 <= size; i += 8) {
+    const __m512i values = _mm512_loadu_si512(keys + i);
+    const __mmask8 less = _mm512_cmplt_epu64_mask(values, needle);
+    if (less != 0xFF) return i + __builtin_popcount(less);
+  }
+  if (i < size) {
+    const __mmask8 valid = (1u << (size - i)) - 1;
+    const __m512i values = _mm512_maskz_loadu_epi64(valid, keys + i);
+    i += __builtin_popcount(_mm512_mask_cmplt_epu64_mask(valid, values, needle));
+  }
+  return i;
+#elif defined(__AVX2__)
+  // AVX2 only has signed comparisons, hence flip the sign bits.
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i needle = _mm256_xor_si256(_mm256_set1_epi64x(key), sign);
+  for (; i + 4 <= size; i += 4) {
+    const __m256i values = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i)), sign);
+    const int less = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpgt_epi64(needle, values)));
+    if (less != 0xF) return i + __builtin_popcount(less);
+  }
+#endif
+  while (i < size && keys[i] < key) ++i;
+  return i;
+}
+
+// Number of keys below which `LowerBound` switches to a linear scan.
+constexpr size_t kLinearSearchThreshold = 32;
+
+// Returns the index of the first key in [keys, keys + size) that is not
+// smaller than `key`, or `size` if there is none. Runs a branchless binary
+// search until at most `kLinearSearchThreshold` keys are left and scans them
+// with `CountLess`.
+template <class KeyType>
+size_t LowerBound(const KeyType* keys, size_t size, KeyType key) {
+  const KeyType* base = keys;
+  while (size > kLinearSearchThreshold) {
+    const size_t half = size / 2;
+    base = (base[half] < key) ? base + half : base;
+    size -= half;
+  }
+  return (base - keys) + CountLess(base, size, key);
+}
+
+}  // namespace simd
+}  // namespace rs
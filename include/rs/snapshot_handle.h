@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "allocator.h"
+
+namespace rs {
+
+// Publishes immutable snapshots of an index, e.g., a `RadixSpline` or a
+// `MultiMap`, to concurrent readers and reclaims replaced snapshots with
+// epoch-based reclamation.
+//
+// Each reader thread owns a `Reader` with a private, cache-line-sized slot.
+// Pinning stores the current epoch into the slot, which is a plain store to
+// an uncontended cache line followed by a fence, instead of an atomic
+// read-modify-write on a shared reference count. `Publish` swaps the snapshot,
+// advances the epoch, and waits until no reader is pinned to an older epoch
+// before it deletes the replaced snapshot.
+template <class T>
+class SnapshotHandle {
+ public:
+  // Maximum number of concurrently registered readers.
+  static constexpr size_t kMaxReaders = 256;
+
+  explicit SnapshotHandle(std::unique_ptr<const T> snapshot)
+      : current_(snapshot.release()) {
+    for (Slot& slot : slots_) {
+      slot.epoch.store(kUnpinned, std::memory_order_relaxed);
+      slot.in_use.store(false, std::memory_order_relaxed);
+    }
+  }
+
+  SnapshotHandle(const SnapshotHandle&) = delete;
+  SnapshotHandle& operator=(const SnapshotHandle&) = delete;
+
+  // All readers need to be destroyed before the handle.
+  ~SnapshotHandle() { delete current_.load(std::memory_order_acquire); }
+
+  // Pins snapshots on behalf of a single thread.
+  class Reader;
+
+  // Replaces the current snapshot and deletes the old one once no reader
+  // can access it anymore. Blocks until then, readers are never blocked.
+  void Publish(std::unique_ptr<const T> snapshot) {
+    std::lock_guard<std::mutex> lock(publish_mutex_);
+    const T* old_snapshot =
+        current_.exchange(snapshot.release(), std::memory_order_acq_rel);
+    const uint64_t epoch = epoch_.fetch_add(1, std::memory_order_acq_rel) + 1;
+    // Pairs with the fence in `Reader::Pin`: a reader either publishes its
+    // slot before this scan or loads the new snapshot.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (const Slot& slot : slots_) {
+      while (true) {
+        const uint64_t reader_epoch =
+            slot.epoch.load(std::memory_order_acquire);
+        if (reader_epoch == kUnpinned || reader_epoch >= epoch) break;
+        std::this_thread::yield();
+      }
+    }
+    delete old_snapshot;
+  }
+
+ private:
+  static constexpr uint64_t kUnpinned = 0;
+
+  // Reader state, padded to a cache line to avoid false sharing.
+  struct alignas(kCacheLineSize) Slot {
+    std::atomic<uint64_t> epoch;
+    std::atomic<bool> in_use;
+  };
+
+  std::atomic<const T*> current_;
+  // Starts after `kUnpinned`.
+  std::atomic<uint64_t> epoch_{1};
+  std::mutex publish_mutex_;
+  Slot slots_[kMaxReaders];
+};
+
+template <class T>
+class SnapshotHandle<T>::Reader {
+ public:
+  // Registers with `handle`. Waits for a free slot if there are
+  // `kMaxReaders` registered readers.
+  explicit Reader(SnapshotHandle* handle) : handle_(handle) {
+    while (true) {
+      for (Slot& slot : handle_->slots_) {
+        bool in_use = false;
+        if (slot.in_use.compare_exchange_strong(in_use, true)) {
+          slot_ = &slot;
+          return;
+        }
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  Reader(const Reader&) = delete;
+  Reader& operator=(const Reader&) = delete;
+
+  ~Reader() {
+    Unpin();
+    slot_->in_use.store(false, std::memory_order_release);
+  }
+
+  // Returns the current snapshot, which stays valid until `Unpin`.
+  const T* Pin() {
+    slot_->epoch.store(handle_->epoch_.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    // Orders the slot store before the snapshot load, pairs with the fence
+    // in `Publish`.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return handle_->current_.load(std::memory_order_acquire);
+  }
+
+  // Releases the pinned snapshot.
+  void Unpin() { slot_->epoch.store(kUnpinned, std::memory_order_release); }
+
+ private:
+  SnapshotHandle* handle_;
+  Slot* slot_;
+};
+
+template <class T>
+constexpr size_t SnapshotHandle<T>::kMaxReaders;
+template <class T>
+constexpr uint64_t SnapshotHandle<T>::kUnpinned;
+
+}  // namespace rs
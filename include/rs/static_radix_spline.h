@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "radix_spline.h"
+#include "search.h"
+
+namespace rs {
+
+// A view on a `RadixSpline` whose number of radix bits and error bound are
+// compile-time constants. The search window then has a constant size of
+// `kWindowSize` elements, which lets the compiler fully unroll the last-mile
+// search. Only the search uses the constants: the estimate goes through the
+// runtime model, whose radix prefix depends on the shift bits of the key
+// range and whose segment search and interpolation don't depend on either
+// constant.
+template <class KeyType, size_t kNumRadixBits, size_t kMaxError>
+class StaticRadixSpline {
+ public:
+  // Number of elements of a search window.
+  static constexpr size_t kWindowSize = 2 * kMaxError + 2;
+
+  StaticRadixSpline() = default;
+
+  // Points to `view`, which needs to be built with `kNumRadixBits` and
+  // `kMaxError`, see `IsCompatible`, and to outlive this model.
+  explicit StaticRadixSpline(const RadixSplineView<KeyType>& view)
+      : view_(view) {
+    assert(IsCompatible(view_));
+  }
+  explicit StaticRadixSpline(const RadixSpline<KeyType>& rs)
+      : StaticRadixSpline(rs.View()) {}
+  explicit StaticRadixSpline(RadixSpline<KeyType>&& rs) = delete;
+
+  // Returns true if `view` was built with `kNumRadixBits` and `kMaxError`.
+  static bool IsCompatible(const RadixSplineView<KeyType>& view) {
+    return view.num_radix_bits_ == kNumRadixBits &&
+           view.max_error_ == kMaxError;
+  }
+  static bool IsCompatible(const RadixSpline<KeyType>& rs) {
+    return IsCompatible(rs.View());
+  }
+
+  // Returns the estimated position of `key`.
+  double GetEstimatedPosition(const KeyType key) const {
+    return view_.GetEstimatedPosition(key);
+  }
+
+  // Returns a search bound [begin, end) around the estimated position.
+  SearchBound GetSearchBound(const KeyType key) const {
+    const size_t estimate = GetEstimatedPosition(key);
+    const size_t begin = (estimate < kMaxError) ? 0 : (estimate - kMaxError);
+    // `end` is exclusive.
+    const size_t end = (estimate + kMaxError + 2 > view_.num_keys_)
+                           ? view_.num_keys_
+                           : (estimate + kMaxError + 2);
+    return SearchBound{begin, end};
+  }
+
+  // Returns the position of the first element of `data` whose key is not
+  // smaller than `key`, see `RadixSpline::LowerBound`. Searches a window of
+  // exactly `kWindowSize` elements, shifted inwards at the data boundaries,
+  // with a fully unrolled branchless binary search.
+  template <class Iterator, class GetKey = KeyIdentity>
+  size_t LowerBound(Iterator data, const KeyType key,
+                    const GetKey& get_key = GetKey()) const {
+    const size_t num_keys = view_.num_keys_;
+    if (num_keys < kWindowSize)
+      return view_.template LowerBound<BinarySearch>(data, key, get_key);
+
+    const size_t estimate = GetEstimatedPosition(key);
+    const size_t begin =
+        std::min(estimate < kMaxError ? 0 : estimate - kMaxError,
+                 num_keys - kWindowSize);
+    Iterator result = data + begin;
+    for (size_t size = kWindowSize; size > 1; size -= size / 2)
+      result = (get_key(result[size / 2]) < key) ? result + size / 2 : result;
+    result += get_key(*result) < key;
+    RS_TRACE_LOOKUP(bound_width, kWindowSize);
+
+    // Same fallback as in `RadixSplineView::LowerBoundWithin`.
+    const size_t position = result - data;
+    if ((position == begin + kWindowSize && position < num_keys) ||
+        (position == begin && begin > 0)) {
+      RS_TRACE_LOOKUP(fallback, true);
+      result = ExponentialSearch::LowerBound(data, data + num_keys, result, key,
+                                             get_key);
+    }
+    return result - data;
+  }
+
+  // Returns the view on the runtime model.
+  const RadixSplineView<KeyType>& View() const { return view_; }
+
+  // Returns the size in bytes, including the referenced arrays.
+  size_t GetSize() const { return view_.GetSize(); }
+
+ private:
+  RadixSplineView<KeyType> view_;
+};
+
+template <class KeyType, size_t kNumRadixBits, size_t kMaxError>
+constexpr size_t StaticRadixSpline<KeyType, kNumRadixBits,
+                                   kMaxError>::kWindowSize;
+
+// A <num_radix_bits, max_error> config for `DispatchStatic`.
+template <size_t kNumRadixBits, size_t kMaxError>
+struct StaticConfig {};
+
+// A list of `StaticConfig`s.
+template <class... Configs>
+struct StaticConfigList {};
+
+// The configs that `DispatchStatic` instantiates by default: the defaults of
+// `Builder` and a few tighter error bounds with larger radix tables.
+using DefaultStaticConfigs =
+    StaticConfigList<StaticConfig<18, 32>, StaticConfig<18, 16>,
+                     StaticConfig<18, 8>, StaticConfig<20, 4>,
+                     StaticConfig<22, 2>, StaticConfig<24, 1>>;
+
+namespace internal {
+
+template <class KeyType, class Function>
+void DispatchStatic(const RadixSpline<KeyType>& rs, Function&& function,
+                    StaticConfigList<>) {
+  function(rs);
+}
+
+template <class KeyType, class Function, size_t kNumRadixBits,
+          size_t kMaxError, class... Configs>
+void DispatchStatic(const RadixSpline<KeyType>& rs, Function&& function,
+                    StaticConfigList<StaticConfig<kNumRadixBits, kMaxError>,
+                                     Configs...>) {
+  using Static = StaticRadixSpline<KeyType, kNumRadixBits, kMaxError>;
+  if (Static::IsCompatible(rs)) {
+    const Static spline(rs);
+    function(spline);
+    return;
+  }
+  DispatchStatic(rs, std::forward<Function>(function),
+                 StaticConfigList<Configs...>());
+}
+
+}  // namespace internal
+
+// Calls `function` with a `StaticRadixSpline` on `rs` if `rs` was built with
+// one of the configs in `Configs`, and with `rs` itself otherwise. Both offer
+// `GetEstimatedPosition`, `GetSearchBound` and `LowerBound`, e.g., for a
+// generic lambda. Doesn't copy `rs`.
+template <class Configs = DefaultStaticConfigs, class KeyType, class Function>
+void DispatchStatic(const RadixSpline<KeyType>& rs, Function&& function) {
+  internal::DispatchStatic(rs, std::forward<Function>(function), Configs());
+}
+
+}  // namespace rs
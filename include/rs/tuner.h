@@ -0,0 +1,221 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <vector>
+
+#include "allocator.h"
+#include "builder.h"
+#include "radix_spline.h"
+
+namespace rs {
+
+// A `num_radix_bits` and `max_error` configuration with its estimated size
+// and lookup latency.
+struct TuningConfig {
+  size_t num_radix_bits;
+  size_t max_error;
+  // Estimated `RadixSpline::GetSize()`.
+  size_t size_in_bytes;
+  // Estimated latency of a lookup including the final search in the data.
+  double latency_ns;
+};
+
+// Machine parameters of the lookup cost model.
+struct CostModel {
+  // Latency of a random access that misses the cache.
+  double cache_miss_ns = 80;
+  // Latency of a random access that hits the cache.
+  double cache_hit_ns = 4;
+  // Size of the last-level cache.
+  size_t cache_size = 32 << 20;
+  // Latency of a single comparison of a search.
+  double search_step_ns = 1;
+  // Size of an element of the searched data, e.g., a key-value pair.
+  size_t element_size = 16;
+};
+
+// Chooses `num_radix_bits` and `max_error` for a sorted array of keys.
+//
+// Evaluates a grid of configurations. The spline does not depend on
+// `num_radix_bits`, so there is one `Builder` run per `max_error` over a
+// strided sample of the keys. Sizes follow from the sampled models and the
+// radix table size, latencies from a cost model that counts the cache lines
+// touched by the radix table lookup, the spline segment search, and the final
+// search in the data. With sampling, the spline sizes of `max_error` values
+// below the sampling stride are approximate.
+template <class KeyType>
+class Tuner {
+ public:
+  Tuner(const KeyType* keys, size_t num_keys, size_t max_sample_size = 1 << 22,
+        const CostModel& cost_model = CostModel())
+      : cost_model_(cost_model) {
+    assert(num_keys > 0);
+    const size_t stride = (num_keys + max_sample_size - 1) / max_sample_size;
+    std::vector<KeyType> sample;
+    sample.reserve(num_keys / stride + 1);
+    for (size_t i = 0; i < num_keys; i += stride) sample.push_back(keys[i]);
+    // The models need to cover the largest key.
+    if (sample.back() != keys[num_keys - 1])
+      sample.push_back(keys[num_keys - 1]);
+
+    // Lookups are assumed to follow the key distribution.
+    std::vector<KeyType> lookup_keys;
+    const size_t lookup_stride = (sample.size() + kNumLookupKeys - 1) /
+                                 kNumLookupKeys;
+    for (size_t i = 0; i < sample.size(); i += lookup_stride)
+      lookup_keys.push_back(sample[i]);
+
+    const KeyType min_key = sample.front();
+    const KeyType max_key = sample.back();
+    for (size_t max_error = 1; max_error <= kMaxMaxError; max_error *= 2) {
+      Builder<KeyType> rsb(min_key, max_key, kMinRadixBits,
+                           std::max<size_t>(max_error / stride, 1));
+      rsb.AddKeys(sample.begin(), sample.end());
+      const RadixSpline<KeyType> rs = rsb.Finalize();
+      const size_t spline_size = rs.GetSize() - rs.radix_table_.GetSize();
+
+      for (size_t num_radix_bits = kMinRadixBits;
+           num_radix_bits <= kMaxRadixBits; num_radix_bits += 2) {
+        const size_t num_shift_bits = Builder<KeyType>::GetNumShiftBits(
+            max_key - min_key, num_radix_bits);
+        const size_t max_prefix = (max_key - min_key) >> num_shift_bits;
+        const size_t radix_table_size = (max_prefix + 2) * sizeof(uint32_t);
+
+        TuningConfig config;
+        config.num_radix_bits = num_radix_bits;
+        config.max_error = max_error;
+        config.size_in_bytes = spline_size + radix_table_size;
+        config.latency_ns = EstimateLatency(
+            rs.spline_keys_, lookup_keys, min_key, num_shift_bits, max_error,
+            radix_table_size, spline_size);
+        configs_.push_back(config);
+      }
+    }
+
+    // Keep the Pareto-optimal configurations, i.e., those that are faster
+    // than every smaller one.
+    std::sort(configs_.begin(), configs_.end(),
+              [](const TuningConfig& lhs, const TuningConfig& rhs) {
+                if (lhs.size_in_bytes != rhs.size_in_bytes)
+                  return lhs.size_in_bytes < rhs.size_in_bytes;
+                return lhs.latency_ns < rhs.latency_ns;
+              });
+    for (const TuningConfig& config : configs_) {
+      if (pareto_configs_.empty() ||
+          config.latency_ns < pareto_configs_.back().latency_ns)
+        pareto_configs_.push_back(config);
+    }
+  }
+
+  // Returns all evaluated configurations ordered by size.
+  const std::vector<TuningConfig>& GetConfigs() const { return configs_; }
+
+  // Returns the Pareto-optimal configurations ordered by size (ascending) and
+  // latency (descending).
+  const std::vector<TuningConfig>& GetParetoConfigs() const {
+    return pareto_configs_;
+  }
+
+  // Stores the fastest configuration that takes at most `max_size_in_bytes`
+  // in `config`. Returns false if there is none.
+  bool TuneForMemoryBudget(size_t max_size_in_bytes,
+                           TuningConfig* config) const {
+    bool found = false;
+    for (const TuningConfig& candidate : pareto_configs_) {
+      if (candidate.size_in_bytes > max_size_in_bytes) break;
+      *config = candidate;
+      found = true;
+    }
+    return found;
+  }
+
+  // Stores the smallest configuration with a latency of at most
+  // `max_latency_ns` in `config`. Returns false if there is none.
+  bool TuneForLatency(double max_latency_ns, TuningConfig* config) const {
+    for (const TuningConfig& candidate : pareto_configs_) {
+      if (candidate.latency_ns <= max_latency_ns) {
+        *config = candidate;
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  static constexpr size_t kMinRadixBits = 4;
+  static constexpr size_t kMaxRadixBits = 28;
+  static constexpr size_t kMaxMaxError = 1024;
+  static constexpr size_t kNumLookupKeys = 1 << 16;
+
+  // Returns the latency of a random access into `num_bytes` of memory.
+  double GetAccessLatency(size_t num_bytes) const {
+    const double miss_ratio =
+        std::max(0.0, 1.0 - static_cast<double>(cost_model_.cache_size) /
+                                static_cast<double>(num_bytes));
+    return miss_ratio * cost_model_.cache_miss_ns +
+           (1 - miss_ratio) * cost_model_.cache_hit_ns;
+  }
+
+  // Returns the number of cache lines that a binary search over `num_bytes`
+  // touches.
+  static double GetNumSearchedCacheLines(double num_bytes) {
+    return 1 + std::log2(std::max(1.0, num_bytes / kCacheLineSize));
+  }
+
+  // Returns the average latency of looking up `lookup_keys` on a model with
+  // the given spline and radix table.
+  double EstimateLatency(const AlignedVector<KeyType>& spline_keys,
+                         const std::vector<KeyType>& lookup_keys,
+                         KeyType min_key, size_t num_shift_bits,
+                         size_t max_error, size_t radix_table_size,
+                         size_t spline_size) const {
+    // The radix table narrows the segment search to the spline points with
+    // the prefix of the lookup key.
+    double segment_search_ns = 0;
+    const auto get_prefix = [&](KeyType key) -> size_t {
+      return (key - min_key) >> num_shift_bits;
+    };
+    for (const KeyType key : lookup_keys) {
+      const size_t prefix = get_prefix(key);
+      const auto begin = std::partition_point(
+          spline_keys.begin(), spline_keys.end(),
+          [&](KeyType spline_key) { return get_prefix(spline_key) < prefix; });
+      const auto end = std::partition_point(
+          begin, spline_keys.end(),
+          [&](KeyType spline_key) { return get_prefix(spline_key) == prefix; });
+      const double num_points = end - begin;
+      segment_search_ns +=
+          GetNumSearchedCacheLines(num_points * sizeof(KeyType)) *
+              GetAccessLatency(spline_size) +
+          std::log2(num_points + 1) * cost_model_.search_step_ns;
+    }
+    segment_search_ns /= lookup_keys.size();
+
+    // Interpolation reads the positions of the segment, the data is assumed
+    // not to be cached.
+    const double window = 2 * max_error + 2;
+    const double final_search_ns =
+        GetNumSearchedCacheLines(window * cost_model_.element_size) *
+            cost_model_.cache_miss_ns +
+        std::log2(window) * cost_model_.search_step_ns;
+    return GetAccessLatency(radix_table_size) + segment_search_ns +
+           GetAccessLatency(spline_size) + final_search_ns;
+  }
+
+  const CostModel cost_model_;
+  std::vector<TuningConfig> configs_;
+  std::vector<TuningConfig> pareto_configs_;
+};
+
+template <class KeyType>
+constexpr size_t Tuner<KeyType>::kMinRadixBits;
+template <class KeyType>
+constexpr size_t Tuner<KeyType>::kMaxRadixBits;
+template <class KeyType>
+constexpr size_t Tuner<KeyType>::kMaxMaxError;
+template <class KeyType>
+constexpr size_t Tuner<KeyType>::kNumLookupKeys;
+
+}  // namespace rs
@@ -0,0 +1,306 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "multi_map.h"
+
+namespace rs {
+
+// A `MultiMap` that supports inserts and erases. Updates go to a small sorted
+// delta that lookups merge with the read-only base `MultiMap`. Once the delta
+// holds `max_delta_size` updates, it is frozen and merged into a new base on a
+// background thread, while a fresh delta takes further updates.
+//
+// A finished merge is only installed by the next update or `WaitForMerge`,
+// never by lookups. Until then, lookups stay correct but keep searching the
+// old base and the frozen delta. Read-mostly callers should therefore call
+// `WaitForMerge` after a batch of updates. Lookups don't install merges
+// because they are const: they must be safe to run concurrently, and they
+// must not invalidate iterators.
+//
+// Like the standard containers, concurrent calls need external
+// synchronization if one of them is an update. Updates invalidate iterators.
+template <class KeyType, class ValueType>
+class UpdatableMultiMap {
+ public:
+  // Member type definitions.
+  using key_type = KeyType;
+  using mapped_type = ValueType;
+  using value_type = std::pair<KeyType, ValueType>;
+  using size_type = std::size_t;
+  class const_iterator;
+
+  // Constructor, creates a copy of the data.
+  template <class BidirIt>
+  UpdatableMultiMap(BidirIt first, BidirIt last, size_t num_radix_bits = 18,
+                    size_t max_error = 32, size_t max_delta_size = 1 << 16)
+      : num_radix_bits_(num_radix_bits),
+        max_error_(max_error),
+        max_delta_size_(max_delta_size),
+        base_(std::make_shared<const MultiMap<KeyType, ValueType>>(
+            first, last, num_radix_bits, max_error)),
+        frozen_delta_(std::make_shared<const Delta>()),
+        size_(base_->size()) {}
+
+  // Lookup functions, like in std::multimap.
+  const_iterator find(KeyType key) const {
+    const const_iterator iter = lower_bound(key);
+    return (iter != end() && iter->first == key) ? iter : end();
+  }
+  const_iterator lower_bound(KeyType key) const {
+    return const_iterator(this, base_->lower_bound(key),
+                          frozen_delta_->inserts.lower_bound(key),
+                          active_delta_.inserts.lower_bound(key));
+  }
+  size_type count(KeyType key) const {
+    size_type result = 0;
+    for (auto iter = find(key); iter != end() && iter->first == key; ++iter)
+      ++result;
+    return result;
+  }
+
+  // Modifiers, like in std::multimap.
+  void insert(const value_type& value) {
+    PossiblyInstallMerge();
+    active_delta_.inserts.insert(value);
+    ++size_;
+    PossiblyStartMerge();
+  }
+  // Erases all elements with `key` and returns their number.
+  size_type erase(KeyType key) {
+    PossiblyInstallMerge();
+    const size_type num_erased = count(key);
+    const auto range = active_delta_.inserts.equal_range(key);
+    const size_type num_active_erased =
+        std::distance(range.first, range.second);
+    active_delta_.inserts.erase(range.first, range.second);
+    // Hide the elements of the base and the frozen delta.
+    if (num_erased > num_active_erased) active_delta_.erased_keys.insert(key);
+    size_ -= num_erased;
+    PossiblyStartMerge();
+    return num_erased;
+  }
+
+  // Blocks until a running merge finishes and installs its result.
+  void WaitForMerge() {
+    if (!merge_.valid()) return;
+    merge_.wait();
+    PossiblyInstallMerge();
+  }
+
+  // Iterators.
+  const_iterator begin() const {
+    return const_iterator(this, base_->begin(), frozen_delta_->inserts.begin(),
+                          active_delta_.inserts.begin());
+  }
+  const_iterator end() const {
+    return const_iterator(this, base_->end(), frozen_delta_->inserts.end(),
+                          active_delta_.inserts.end());
+  }
+
+  // Size.
+  std::size_t size() const { return size_; }
+
+ private:
+  // Orders elements by key only, so that elements with equal keys stay in
+  // insertion order.
+  struct KeyCompare {
+    using is_transparent = void;
+    bool operator()(const value_type& lhs, const value_type& rhs) const {
+      return lhs.first < rhs.first;
+    }
+    bool operator()(const value_type& lhs, const KeyType& rhs) const {
+      return lhs.first < rhs;
+    }
+    bool operator()(const KeyType& lhs, const value_type& rhs) const {
+      return lhs < rhs.first;
+    }
+  };
+
+  // Updates since the base was built.
+  struct Delta {
+    std::multiset<value_type, KeyCompare> inserts;
+    // Keys whose elements in older layers are erased.
+    std::set<KeyType> erased_keys;
+
+    size_t size() const { return inserts.size() + erased_keys.size(); }
+  };
+
+  using Base = MultiMap<KeyType, ValueType>;
+
+  // Freezes the active delta and starts merging it into a new base, unless a
+  // merge is already running.
+  void PossiblyStartMerge() {
+    if (active_delta_.size() < max_delta_size_ || merge_.valid()) return;
+    frozen_delta_ = std::make_shared<const Delta>(std::move(active_delta_));
+    active_delta_ = Delta();
+    merge_ = std::async(std::launch::async, &UpdatableMultiMap::Merge, base_,
+                        frozen_delta_, num_radix_bits_, max_error_);
+  }
+
+  // Replaces the base with the result of a finished merge.
+  void PossiblyInstallMerge() {
+    if (!merge_.valid() || merge_.wait_for(std::chrono::seconds(0)) !=
+                               std::future_status::ready)
+      return;
+    base_ = merge_.get();
+    frozen_delta_ = std::make_shared<const Delta>();
+  }
+
+  // Returns a new base with the elements of `base` and `delta`.
+  static std::shared_ptr<const Base> Merge(std::shared_ptr<const Base> base,
+                                           std::shared_ptr<const Delta> delta,
+                                           size_t num_radix_bits,
+                                           size_t max_error) {
+    std::vector<value_type> data;
+    data.reserve(base->size() + delta->inserts.size());
+    auto insert_iter = delta->inserts.begin();
+    for (const value_type& element : *base) {
+      // Elements of the base come first among equal keys.
+      for (; insert_iter != delta->inserts.end() &&
+             insert_iter->first < element.first;
+           ++insert_iter)
+        data.push_back(*insert_iter);
+      if (delta->erased_keys.count(element.first) == 0)
+        data.push_back(element);
+    }
+    data.insert(data.end(), insert_iter, delta->inserts.end());
+    return std::make_shared<const Base>(std::move(data), num_radix_bits,
+                                        max_error);
+  }
+
+  const size_t num_radix_bits_;
+  const size_t max_error_;
+  const size_t max_delta_size_;
+
+  // Layers from old to new. Lookups see the elements of all layers that are
+  // not erased by a newer one.
+  std::shared_ptr<const Base> base_;
+  std::shared_ptr<const Delta> frozen_delta_;
+  Delta active_delta_;
+
+  // Running merge of `base_` and `frozen_delta_`.
+  std::future<std::shared_ptr<const Base>> merge_;
+  size_t size_;
+};
+
+// Iterates over the merged layers in key order. Among equal keys, older layers
+// come first.
+template <class KeyType, class ValueType>
+class UpdatableMultiMap<KeyType, ValueType>::const_iterator {
+ public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = typename UpdatableMultiMap::value_type;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const value_type*;
+  using reference = const value_type&;
+
+  const_iterator() = default;
+
+  reference operator*() const { return *operator->(); }
+  pointer operator->() const {
+    switch (GetLayer()) {
+      case kBase:
+        return &*base_iter_;
+      case kFrozenDelta:
+        return &*frozen_iter_;
+      default:
+        return &*active_iter_;
+    }
+  }
+
+  const_iterator& operator++() {
+    switch (GetLayer()) {
+      case kBase:
+        ++base_iter_;
+        break;
+      case kFrozenDelta:
+        ++frozen_iter_;
+        break;
+      default:
+        ++active_iter_;
+        break;
+    }
+    SkipErased();
+    return *this;
+  }
+  const_iterator operator++(int) {
+    const_iterator result = *this;
+    ++*this;
+    return result;
+  }
+
+  bool operator==(const const_iterator& other) const {
+    return base_iter_ == other.base_iter_ &&
+           frozen_iter_ == other.frozen_iter_ &&
+           active_iter_ == other.active_iter_;
+  }
+  bool operator!=(const const_iterator& other) const {
+    return !(*this == other);
+  }
+
+ private:
+  using BaseIterator = typename Base::const_iterator;
+  using DeltaIterator =
+      typename std::multiset<value_type, KeyCompare>::const_iterator;
+  enum Layer { kBase, kFrozenDelta, kActiveDelta };
+
+  const_iterator(const UpdatableMultiMap* map, BaseIterator base_iter,
+                 DeltaIterator frozen_iter, DeltaIterator active_iter)
+      : map_(map),
+        base_iter_(base_iter),
+        frozen_iter_(frozen_iter),
+        active_iter_(active_iter) {
+    SkipErased();
+  }
+
+  // Returns the layer of the current element, i.e., the one with the
+  // smallest key, preferring older layers.
+  Layer GetLayer() const {
+    Layer layer = kActiveDelta;
+    const value_type* current =
+        (active_iter_ != map_->active_delta_.inserts.end()) ? &*active_iter_
+                                                            : nullptr;
+    if (frozen_iter_ != map_->frozen_delta_->inserts.end() &&
+        (current == nullptr || !(current->first < frozen_iter_->first))) {
+      layer = kFrozenDelta;
+      current = &*frozen_iter_;
+    }
+    if (base_iter_ != map_->base_->end() &&
+        (current == nullptr || !(current->first < base_iter_->first)))
+      layer = kBase;
+    return layer;
+  }
+
+  // Moves past elements that a newer layer erased.
+  void SkipErased() {
+    const auto& frozen_erased = map_->frozen_delta_->erased_keys;
+    const auto& active_erased = map_->active_delta_.erased_keys;
+    if (!frozen_erased.empty() || !active_erased.empty()) {
+      while (base_iter_ != map_->base_->end() &&
+             (frozen_erased.count(base_iter_->first) > 0 ||
+              active_erased.count(base_iter_->first) > 0))
+        ++base_iter_;
+    }
+    if (!active_erased.empty()) {
+      while (frozen_iter_ != map_->frozen_delta_->inserts.end() &&
+             active_erased.count(frozen_iter_->first) > 0)
+        ++frozen_iter_;
+    }
+  }
+
+  const UpdatableMultiMap* map_ = nullptr;
+  BaseIterator base_iter_;
+  DeltaIterator frozen_iter_;
+  DeltaIterator active_iter_;
+
+  friend class UpdatableMultiMap;
+};
+
+}  // namespace rs
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace util {
+
+// Returns a timestamp in ticks of the time stamp counter, or in ns of
+// `std::chrono::steady_clock` where there is none.
+inline uint64_t read_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Returns the number of ticks of `read_ticks` per ns, measured once.
+inline double ticks_per_ns() {
+  static const double result = []() {
+    const auto clock_begin = std::chrono::steady_clock::now();
+    const uint64_t ticks_begin = read_ticks();
+    while (std::chrono::steady_clock::now() - clock_begin <
+           std::chrono::milliseconds(20)) {
+    }
+    const uint64_t ticks_end = read_ticks();
+    const auto clock_end = std::chrono::steady_clock::now();
+    return (ticks_end - ticks_begin) /
+           static_cast<double>(
+               std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   clock_end - clock_begin)
+                   .count());
+  }();
+  return result;
+}
+
+// Histogram with a bounded relative error, in the style of HdrHistogram.
+// Values below 2^kSubBucketBits are counted exactly, larger values in
+// 2^kSubBucketBits sub-buckets per power of two, i.e., with an error of at
+// most 1/2^kSubBucketBits. Recording is a few instructions.
+class LatencyHistogram {
+ public:
+  static constexpr uint64_t kSubBucketBits = 5;
+  static constexpr uint64_t kNumSubBuckets = uint64_t{1} << kSubBucketBits;
+
+  LatencyHistogram() : counts_((64 - kSubBucketBits + 1) * kNumSubBuckets) {}
+
+  void Record(uint64_t value) {
+    ++counts_[GetBucket(value)];
+    ++count_;
+    max_ = std::max(max_, value);
+  }
+
+  // Adds the values of `other`.
+  void Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < counts_.size(); ++i) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  uint64_t Count() const { return count_; }
+  uint64_t Max() const { return max_; }
+
+  // Returns the value at `quantile` in [0, 1], e.g., 0.99 for p99, within the
+  // error bound, or 0 if there are no values.
+  uint64_t Percentile(double quantile) const {
+    if (count_ == 0) return 0;
+    const uint64_t rank =
+        std::max<uint64_t>(1, static_cast<uint64_t>(quantile * count_ + 0.5));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+      seen += counts_[bucket];
+      if (seen >= rank) return std::min(GetBucketMidpoint(bucket), max_);
+    }
+    return max_;
+  }
+
+ private:
+  static size_t GetBucket(uint64_t value) {
+    if (value < kNumSubBuckets) return value;
+    const uint64_t exponent = 63 - __builtin_clzll(value);
+    const uint64_t shift = exponent - kSubBucketBits;
+    // The leading bit is implicit in `exponent`.
+    const uint64_t sub_bucket = (value >> shift) - kNumSubBuckets;
+    return (shift + 1) * kNumSubBuckets + sub_bucket;
+  }
+
+  static uint64_t GetBucketMidpoint(size_t bucket) {
+    if (bucket < kNumSubBuckets) return bucket;
+    const uint64_t shift = bucket / kNumSubBuckets - 1;
+    const uint64_t lower = (kNumSubBuckets + bucket % kNumSubBuckets) << shift;
+    return lower + ((uint64_t{1} << shift) >> 1);
+  }
+
+  std::vector<uint64_t> counts_;
+  uint64_t count_ = 0;
+  uint64_t max_ = 0;
+};
+
+}  // namespace util
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace util {
+
+// Hardware performance counters of the calling thread, read through
+// `perf_event_open`. Counts user space only. Events that cannot be opened,
+// e.g., without permissions, in a VM, or on other platforms, are reported as
+// unavailable instead of failing the benchmark.
+class PerfCounters {
+ public:
+  enum Event {
+    kCycles,
+    kInstructions,
+    kLlcMisses,
+    kDtlbMisses,
+    kBranchMisses,
+    kNumEvents
+  };
+
+  // Opens the counters if `enabled`, otherwise all events are unavailable and
+  // `Start` and `Stop` are no-ops.
+  explicit PerfCounters(bool enabled = true) {
+    for (size_t event = 0; event < kNumEvents; ++event) {
+      fds_[event] = enabled ? Open(static_cast<Event>(event)) : -1;
+      counts_[event] = 0;
+    }
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (const int fd : fds_)
+      if (fd >= 0) close(fd);
+#endif
+  }
+
+  // Returns true if `event` is counted.
+  bool IsAvailable(Event event) const { return fds_[event] >= 0; }
+
+  // Resets and starts all counters.
+  void Start() {
+#ifdef __linux__
+    for (const int fd : fds_) {
+      if (fd < 0) continue;
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+  }
+
+  // Stops all counters and reads their values, scaled up if the kernel
+  // multiplexed them.
+  void Stop() {
+#ifdef __linux__
+    for (const int fd : fds_)
+      if (fd >= 0) ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    for (size_t event = 0; event < kNumEvents; ++event) {
+      counts_[event] = 0;
+      if (fds_[event] < 0) continue;
+      // value, time enabled, time running.
+      uint64_t values[3];
+      if (read(fds_[event], values, sizeof(values)) != sizeof(values) ||
+          values[2] == 0)
+        continue;
+      counts_[event] = static_cast<uint64_t>(
+          static_cast<double>(values[0]) * values[1] / values[2]);
+    }
+#endif
+  }
+
+  // Returns the count of `event` between the last `Start` and `Stop`.
+  uint64_t Get(Event event) const { return counts_[event]; }
+
+  // Returns " <event>/<unit>: <count / divisor>" for every event, with "n/a"
+  // for unavailable ones, e.g., " cycles/lookup: 512.3 ...".
+  std::string Format(const std::string& unit, uint64_t divisor) const {
+    static const char* const kNames[kNumEvents] = {
+        "cycles", "instructions", "llc_misses", "dtlb_misses",
+        "branch_misses"};
+    std::ostringstream out;
+    for (size_t event = 0; event < kNumEvents; ++event) {
+      out << " " << kNames[event] << "/" << unit << ": ";
+      if (IsAvailable(static_cast<Event>(event))) {
+        out << static_cast<double>(counts_[event]) / divisor;
+      } else {
+        out << "n/a";
+      }
+    }
+    return out.str();
+  }
+
+ private:
+  // Returns the file descriptor of the counter of `event`, or -1.
+  static int Open(Event event) {
+#ifdef __linux__
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (event) {
+      case kCycles:
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case kInstructions:
+        attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case kLlcMisses:
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        break;
+      case kDtlbMisses:
+        attr.type = PERF_TYPE_HW_CACHE;
+        attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        break;
+      default:
+        attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return syscall(SYS_perf_event_open, &attr, /*pid=*/0, /*cpu=*/-1,
+                   /*group_fd=*/-1, /*flags=*/0);
+#else
+    (void)event;
+    return -1;
+#endif
+  }
+
+  int fds_[kNumEvents];
+  uint64_t counts_[kNumEvents];
+};
+
+}  // namespace util
@@ -0,0 +1,79 @@
+#include "include/rs/allocator.h"
+
+#include <cstdint>
+#include <utility>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+bool IsAligned(const void* ptr, size_t alignment) {
+  return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+TEST(AlignedAllocatorTest, SmallAllocationsAreCacheLineAligned) {
+  for (const auto huge_pages :
+       {rs::HugePages::kNone, rs::HugePages::kTransparent,
+        rs::HugePages::kExplicit}) {
+    rs::AlignedVector<uint8_t> vector(
+        1000, 1, rs::AlignedAllocator<uint8_t>(huge_pages));
+    EXPECT_TRUE(IsAligned(vector.data(), rs::kCacheLineSize));
+  }
+}
+
+TEST(AlignedAllocatorTest, LargeAllocationsStartAtHugePage) {
+  // Not a multiple of the huge page size.
+  const size_t size = 3 * rs::kHugePageSize / sizeof(uint64_t) + 7;
+  for (const auto huge_pages :
+       {rs::HugePages::kTransparent, rs::HugePages::kExplicit}) {
+    rs::AlignedVector<uint64_t> vector(
+        size, 0, rs::AlignedAllocator<uint64_t>(huge_pages));
+    EXPECT_TRUE(IsAligned(vector.data(), rs::kHugePageSize));
+    for (size_t i = 0; i < size; ++i) vector[i] = i;
+    EXPECT_EQ(size - 1, vector.back());
+
+    // Growing remaps the elements.
+    vector.resize(2 * size, 1);
+    EXPECT_TRUE(IsAligned(vector.data(), rs::kHugePageSize));
+    EXPECT_EQ(size - 1, vector[size - 1]);
+    EXPECT_EQ(1u, vector.back());
+  }
+}
+
+TEST(AlignedAllocatorTest, ContainersKeepTheMode) {
+  const size_t size = rs::kHugePageSize / sizeof(uint32_t);
+  rs::AlignedVector<uint32_t> vector(
+      size, 1, rs::AlignedAllocator<uint32_t>(rs::HugePages::kTransparent));
+
+  rs::AlignedVector<uint32_t> copy = vector;
+  EXPECT_EQ(rs::HugePages::kTransparent, copy.get_allocator().huge_pages());
+  EXPECT_TRUE(IsAligned(copy.data(), rs::kHugePageSize));
+
+  rs::AlignedVector<uint32_t> assigned;
+  assigned = copy;
+  EXPECT_EQ(rs::HugePages::kTransparent,
+            assigned.get_allocator().huge_pages());
+  EXPECT_TRUE(IsAligned(assigned.data(), rs::kHugePageSize));
+
+  rs::AlignedVector<uint32_t> moved;
+  moved = std::move(vector);
+  EXPECT_EQ(rs::HugePages::kTransparent, moved.get_allocator().huge_pages());
+  EXPECT_EQ(size, moved.size());
+
+  // Rebinding keeps the mode.
+  const rs::AlignedAllocator<uint8_t> rebound(moved.get_allocator());
+  EXPECT_EQ(rs::HugePages::kTransparent, rebound.huge_pages());
+  EXPECT_TRUE(rebound == moved.get_allocator());
+  EXPECT_TRUE(rebound != rs::AlignedAllocator<uint8_t>());
+}
+
+TEST(AdviseHugePagesTest, ArbitraryRanges) {
+  std::vector<uint8_t> data(3 * rs::kHugePageSize, 1);
+  // Best effort, the data stays intact.
+  rs::AdviseHugePages(data.data(), data.size());
+  rs::AdviseHugePages(data.data() + 1, 100);
+  rs::AdviseHugePages(data.data(), 0);
+  for (const uint8_t value : data) ASSERT_EQ(1, value);
+}
+
+}  // namespace
@@ -0,0 +1,179 @@
+#include "include/rs/disk_index.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Writes `keys` in the format that `DiskIndex` reads and returns the path.
+template <class KeyType>
+std::string WriteKeys(const std::vector<KeyType>& keys,
+                      const std::string& name) {
+  const std::string path = testing::TempDir() + name;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  const uint64_t size = keys.size();
+  out.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  out.write(reinterpret_cast<const char*>(keys.data()),
+            keys.size() * sizeof(KeyType));
+  return path;
+}
+
+// Random keys with long runs of duplicates, which need lookups outside of
+// the search bound.
+template <class KeyType>
+std::vector<KeyType> CreateKeys(size_t seed) {
+  std::vector<KeyType> keys;
+  std::mt19937 g(seed);
+  std::uniform_int_distribution<KeyType> d(0, 1u << 30);
+  for (size_t i = 0; i < 100000; ++i) keys.push_back(d(g));
+  for (size_t i = 0; i < 5000; ++i) keys.push_back(keys[i]);
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+template <class KeyType>
+std::vector<KeyType> CreateLookupKeys(const std::vector<KeyType>& keys) {
+  std::vector<KeyType> lookup_keys = {0, keys.back(),
+                                      static_cast<KeyType>(keys.back() + 1)};
+  for (size_t i = 0; i < keys.size(); i += 97) {
+    lookup_keys.push_back(keys[i]);
+    lookup_keys.push_back(keys[i] - 1);
+    lookup_keys.push_back(keys[i] + 1);
+  }
+  std::shuffle(lookup_keys.begin(), lookup_keys.end(), std::mt19937(42));
+  return lookup_keys;
+}
+
+template <class T>
+struct DiskIndexTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(DiskIndexTest, AllKeyTypes);
+
+TYPED_TEST(DiskIndexTest, LowerBoundMatchesStdLowerBound) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateKeys<KeyType>(/*seed=*/42);
+  const auto lookup_keys = CreateLookupKeys(keys);
+  const std::string path = WriteKeys(keys, "disk_index_test.keys");
+
+  for (const size_t num_cached_pages : {0, 16}) {
+    rs::DiskIndex<KeyType> index;
+    ASSERT_TRUE(index.Open(path, 18, 8, num_cached_pages));
+    ASSERT_EQ(keys.size(), index.size());
+    for (const KeyType key : lookup_keys) {
+      size_t position;
+      ASSERT_TRUE(index.LowerBound(key, &position));
+      ASSERT_EQ(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin(),
+                position)
+          << "key: " << key;
+    }
+
+    std::vector<size_t> positions(lookup_keys.size());
+    ASSERT_TRUE(index.LowerBoundBatch(lookup_keys.data(), lookup_keys.size(),
+                                      positions.data()));
+    for (size_t i = 0; i < lookup_keys.size(); ++i) {
+      ASSERT_EQ(std::lower_bound(keys.begin(), keys.end(), lookup_keys[i]) -
+                    keys.begin(),
+                positions[i])
+          << "key: " << lookup_keys[i];
+    }
+  }
+}
+
+TYPED_TEST(DiskIndexTest, OneReadPerLookup) {
+  using KeyType = typename TestFixture::KeyType;
+  std::vector<KeyType> keys;
+  for (size_t i = 0; i < 100000; ++i) keys.push_back(3 * i);
+  const std::string path = WriteKeys(keys, "disk_index_test.dense");
+
+  rs::DiskIndex<KeyType> index;
+  ASSERT_TRUE(index.Open(path));
+  size_t position;
+  for (size_t i = 0; i < keys.size(); i += 1000) {
+    index.ResetStats();
+    ASSERT_TRUE(index.LowerBound(keys[i], &position));
+    EXPECT_EQ(i, position);
+    EXPECT_EQ(1u, index.stats().num_reads);
+    // The search bound spans at most two pages.
+    EXPECT_LE(index.stats().num_bytes_read, 2 * index.kPageSize);
+    EXPECT_EQ(0u, index.stats().num_bytes_read % index.kPageSize);
+  }
+
+  // Adjacent search bounds are read together.
+  std::vector<KeyType> lookup_keys;
+  for (size_t i = 0; i < 1000; ++i) lookup_keys.push_back(keys[10 * i]);
+  std::vector<size_t> positions(lookup_keys.size());
+  index.ResetStats();
+  ASSERT_TRUE(index.LowerBoundBatch(lookup_keys.data(), lookup_keys.size(),
+                                    positions.data()));
+  for (size_t i = 0; i < lookup_keys.size(); ++i)
+    EXPECT_EQ(10 * i, positions[i]);
+  EXPECT_LT(index.stats().num_reads, 10u);
+}
+
+TYPED_TEST(DiskIndexTest, PageCache) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateKeys<KeyType>(/*seed=*/7);
+  const std::string path = WriteKeys(keys, "disk_index_test.cached");
+
+  rs::DiskIndex<KeyType> index;
+  ASSERT_TRUE(index.Open(path, 18, 8, /*num_cached_pages=*/4));
+  size_t position;
+  ASSERT_TRUE(index.LowerBound(keys[5000], &position));
+  index.ResetStats();
+  ASSERT_TRUE(index.LowerBound(keys[5000], &position));
+  EXPECT_EQ(0u, index.stats().num_reads);
+  EXPECT_GT(index.stats().num_cache_hits, 0u);
+
+  // Lookups on other pages evict it.
+  for (size_t i = 20000; i < 100000; i += 20000)
+    ASSERT_TRUE(index.LowerBound(keys[i], &position));
+  index.ResetStats();
+  ASSERT_TRUE(index.LowerBound(keys[5000], &position));
+  EXPECT_EQ(1u, index.stats().num_reads);
+  EXPECT_EQ(std::lower_bound(keys.begin(), keys.end(), keys[5000]) -
+                keys.begin(),
+            position);
+}
+
+TYPED_TEST(DiskIndexTest, EmptyAndSingleKey) {
+  using KeyType = typename TestFixture::KeyType;
+  rs::DiskIndex<KeyType> index;
+  ASSERT_TRUE(index.Open(WriteKeys(std::vector<KeyType>(), "empty.keys")));
+  size_t position = 1;
+  ASSERT_TRUE(index.LowerBound(42, &position));
+  EXPECT_EQ(0u, position);
+
+  ASSERT_TRUE(index.Open(WriteKeys(std::vector<KeyType>{7}, "single.keys")));
+  ASSERT_TRUE(index.LowerBound(7, &position));
+  EXPECT_EQ(0u, position);
+  ASSERT_TRUE(index.LowerBound(8, &position));
+  EXPECT_EQ(1u, position);
+}
+
+TEST(DiskIndexTest, InvalidFiles) {
+  rs::DiskIndex<uint64_t> index;
+  EXPECT_FALSE(index.Open(testing::TempDir() + "does_not_exist.keys"));
+
+  // Unsorted.
+  EXPECT_FALSE(index.Open(
+      WriteKeys(std::vector<uint64_t>{1, 3, 2}, "unsorted.keys")));
+
+  // Truncated: claims more keys than the file holds.
+  const std::string path = WriteKeys(std::vector<uint64_t>{1, 2}, "trunc.keys");
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    const uint64_t size = 3;
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+  }
+  EXPECT_FALSE(index.Open(path));
+}
+
+}  // namespace
@@ -0,0 +1,85 @@
+#include "include/rs/hierarchical_radix_spline.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "include/rs/builder.h"
+#include "include/rs/hierarchical_builder.h"
+
+namespace {
+
+const size_t kNumKeys = 100000;
+const size_t kNumRadixBits = 12;
+const size_t kMaxError = 4;
+
+// Creates unique keys that are crowded at the beginning of the domain.
+template <class KeyType>
+std::vector<KeyType> CreateSkewedKeys(size_t seed) {
+  std::mt19937 g(seed);
+  std::exponential_distribution<double> d(/*lambda=*/1);
+  const double max = std::numeric_limits<KeyType>::max();
+  std::vector<KeyType> keys;
+  keys.reserve(kNumKeys);
+  for (size_t i = 0; i < kNumKeys; ++i)
+    keys.push_back(std::min(std::pow(d(g), 8), 1e6) / 1e6 * max);
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  return keys;
+}
+
+template <class T>
+struct HierarchicalRadixSplineTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(HierarchicalRadixSplineTest, AllKeyTypes);
+
+TYPED_TEST(HierarchicalRadixSplineTest, MatchesRadixSpline) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/42);
+
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), kNumRadixBits,
+                           kMaxError);
+  rs::HierarchicalBuilder<KeyType> hrsb(keys.front(), keys.back(),
+                                        kNumRadixBits, kMaxError);
+  for (const auto& key : keys) {
+    rsb.AddKey(key);
+    hrsb.AddKey(key);
+  }
+  const auto rs = rsb.Finalize();
+  const auto hrs = hrsb.Finalize();
+  // The skewed keys need refinement.
+  EXPECT_GT(hrs.GetNumNodes(), 1u);
+
+  // Both use the same spline.
+  std::mt19937 g(815);
+  std::uniform_int_distribution<KeyType> d(keys.front(), keys.back());
+  std::vector<KeyType> lookup_keys = keys;
+  for (size_t i = 0; i < kNumKeys; ++i) lookup_keys.push_back(d(g));
+  for (const auto& key : lookup_keys) {
+    ASSERT_EQ(rs.GetEstimatedPosition(key), hrs.GetEstimatedPosition(key))
+        << "key: " << key;
+  }
+
+  for (const auto& key : keys) {
+    const rs::SearchBound bound = hrs.GetSearchBound(key);
+    const size_t position =
+        std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    ASSERT_LE(bound.begin, position) << "key: " << key;
+    ASSERT_GT(bound.end, position) << "key: " << key;
+  }
+}
+
+TYPED_TEST(HierarchicalRadixSplineTest, UniformKeysStayFlat) {
+  using KeyType = typename TestFixture::KeyType;
+  rs::HierarchicalBuilder<KeyType> hrsb(0, 999, /*num_radix_bits=*/8,
+                                        kMaxError);
+  for (KeyType key = 0; key < 1000; ++key) hrsb.AddKey(key);
+  const auto hrs = hrsb.Finalize();
+  EXPECT_EQ(1u, hrs.GetNumNodes());
+  for (KeyType key = 0; key < 1000; ++key)
+    EXPECT_EQ(key, hrs.GetEstimatedPosition(key));
+}
+
+}  // namespace
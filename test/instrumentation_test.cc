@@ -0,0 +1,105 @@
+#include "include/rs/instrumentation.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "include/rs/builder.h"
+#include "include/rs/radix_spline.h"
+
+namespace {
+
+#ifdef RS_INSTRUMENT_LOOKUPS
+
+// Builds a spline on `keys`.
+rs::RadixSpline<uint64_t> Build(const std::vector<uint64_t>& keys,
+                                size_t num_radix_bits, size_t max_error) {
+  rs::Builder<uint64_t> rsb(keys.front(), keys.back(), num_radix_bits,
+                            max_error);
+  rsb.AddKeys(keys.begin(), keys.end());
+  return rsb.Finalize();
+}
+
+TEST(InstrumentationTest, Clamped) {
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 10; i < 1000; ++i) keys.push_back(i);
+  const auto rs = Build(keys, 18, 32);
+
+  rs::LookupTrace trace;
+  rs::SetLookupTrace(&trace);
+  EXPECT_EQ(0u, rs.LowerBound(keys.data(), 5));
+  EXPECT_TRUE(trace.clamped);
+  EXPECT_FALSE(trace.fallback);
+
+  trace = rs::LookupTrace();
+  EXPECT_EQ(490u, rs.LowerBound(keys.data(), 500));
+  EXPECT_FALSE(trace.clamped);
+  EXPECT_EQ(2 * 32 + 2u, trace.bound_width);
+  rs::SetLookupTrace(nullptr);
+}
+
+TEST(InstrumentationTest, SegmentSearch) {
+  // Quadratic keys need many spline points, one radix bit puts them all into
+  // the same bucket.
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 10000; ++i) keys.push_back(i * i);
+  rs::LookupTrace trace;
+  rs::SetLookupTrace(&trace);
+
+  const auto coarse = Build(keys, 1, 1);
+  EXPECT_EQ(5000u, coarse.LowerBound(keys.data(), keys[5000]));
+  EXPECT_GT(trace.segment_range, rs::simd::kLinearSearchThreshold);
+  EXPECT_TRUE(trace.binary_segment_search);
+
+  trace = rs::LookupTrace();
+  const auto fine = Build(keys, 20, 1);
+  EXPECT_EQ(5000u, fine.LowerBound(keys.data(), keys[5000]));
+  EXPECT_LE(trace.segment_range, rs::simd::kLinearSearchThreshold);
+  EXPECT_FALSE(trace.binary_segment_search);
+  rs::SetLookupTrace(nullptr);
+}
+
+TEST(InstrumentationTest, FallbackAndEqualRange) {
+  // A long run of duplicates, followed by a gap.
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 100; ++i) keys.push_back(i);
+  for (uint64_t i = 0; i < 1000; ++i) keys.push_back(100);
+  for (uint64_t i = 1000; i < 1100; ++i) keys.push_back(i);
+  const auto rs = Build(keys, 18, 4);
+
+  rs::LookupTrace trace;
+  rs::SetLookupTrace(&trace);
+  const auto range = rs.EqualRange(keys.data(), 100);
+  EXPECT_EQ(100u, range.first);
+  EXPECT_EQ(1100u, range.second);
+  EXPECT_EQ(1000u, trace.equal_range_size);
+
+  trace = rs::LookupTrace();
+  EXPECT_EQ(1100u, rs.LowerBound(keys.data(), 101));
+  EXPECT_TRUE(trace.fallback);
+  rs::SetLookupTrace(nullptr);
+
+  // Lookups without a trace don't record anything.
+  trace = rs::LookupTrace();
+  rs.LowerBound(keys.data(), 101);
+  EXPECT_FALSE(trace.fallback);
+}
+
+#else
+
+TEST(InstrumentationTest, Disabled) {
+  // Without `RS_INSTRUMENT_LOOKUPS`, lookups don't touch the trace.
+  std::vector<uint64_t> keys = {1, 2, 3};
+  rs::Builder<uint64_t> rsb(keys.front(), keys.back());
+  rsb.AddKeys(keys.begin(), keys.end());
+  const auto rs = rsb.Finalize();
+
+  rs::LookupTrace trace;
+  rs::SetLookupTrace(&trace);
+  EXPECT_EQ(0u, rs.LowerBound(keys.data(), 0));
+  EXPECT_FALSE(trace.clamped);
+  rs::SetLookupTrace(nullptr);
+}
+
+#endif
+
+}  // namespace
@@ -1,5 +1,6 @@
 #include "include/rs/multi_map.h"
 
+#include <map>
 #include <random>
 #include <unordered_set>
 
@@ -115,4 +116,271 @@ TEST(MultiMapTest, Random) {
   }
 }
 
-}  // namespace
\ No newline at end of file
+TEST(MultiMapTest, LowerBoundBatch) {
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  entries.reserve(kNumKeys);
+  std::mt19937 randomness_generator(8128);
+  std::uniform_int_distribution<uint64_t> distribution(0, kNumKeys * 10);
+  while (entries.size() < kNumKeys) {
+    entries.emplace_back(distribution(randomness_generator), entries.size());
+  }
+  rs::MultiMap<uint64_t, uint64_t> map(entries.begin(), entries.end());
+
+  std::vector<uint64_t> lookup_keys;
+  for (size_t key = 0; key < kNumKeys * 10 + 10; ++key)
+    lookup_keys.push_back(key);
+  std::shuffle(lookup_keys.begin(), lookup_keys.end(), randomness_generator);
+
+  std::vector<rs::MultiMap<uint64_t, uint64_t>::const_iterator> results(
+      lookup_keys.size());
+  map.lower_bound_batch(lookup_keys.data(), lookup_keys.size(),
+                        results.data());
+  for (size_t i = 0; i < lookup_keys.size(); ++i)
+    ASSERT_EQ(map.lower_bound(lookup_keys[i]), results[i])
+        << "key: " << lookup_keys[i];
+}
+
+// Keys with runs of duplicates that are longer than the error bound.
+std::vector<std::pair<uint64_t, uint64_t>> CreateDuplicateRuns() {
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  for (uint64_t key = 1; key <= 1000; ++key) {
+    const size_t num_duplicates = (key % 100 == 0) ? 500 : key % 3;
+    for (size_t i = 0; i < num_duplicates; ++i)
+      entries.emplace_back(10 * key, entries.size());
+  }
+  entries.emplace_back(100000, entries.size());
+  return entries;
+}
+
+TEST(MultiMapTest, EqualRange) {
+  const auto entries = CreateDuplicateRuns();
+  const std::multimap<uint64_t, uint64_t> ref(entries.begin(), entries.end());
+  const rs::MultiMap<uint64_t, uint64_t> map(entries.begin(), entries.end(),
+                                             18, 8);
+
+  for (uint64_t key = 0; key <= 100001; ++key) {
+    const auto range = map.equal_range(key);
+    const auto ref_range = ref.equal_range(key);
+    ASSERT_EQ(std::distance(ref.begin(), ref_range.first),
+              range.first - map.begin())
+        << "key: " << key;
+    ASSERT_EQ(std::distance(ref.begin(), ref_range.second),
+              range.second - map.begin())
+        << "key: " << key;
+    ASSERT_EQ(range.second, map.upper_bound(key)) << "key: " << key;
+    ASSERT_EQ(ref.count(key), map.count(key)) << "key: " << key;
+  }
+}
+
+TEST(MultiMapTest, Range) {
+  const auto entries = CreateDuplicateRuns();
+  const rs::MultiMap<uint64_t, uint64_t> map(entries.begin(), entries.end(),
+                                             18, 8);
+
+  std::mt19937 randomness_generator(42);
+  std::uniform_int_distribution<uint64_t> distribution(0, 100001);
+  for (size_t i = 0; i < 1000; ++i) {
+    const uint64_t lo = distribution(randomness_generator);
+    const uint64_t hi = distribution(randomness_generator);
+    const auto range = map.range(lo, hi);
+
+    const size_t expected_size = std::count_if(
+        entries.begin(), entries.end(), [&](const auto& entry) {
+          return lo <= entry.first && entry.first < hi;
+        });
+    ASSERT_EQ(expected_size, range.size()) << "[" << lo << ", " << hi << ")";
+    ASSERT_EQ(map.lower_bound(lo), range.begin());
+    for (const auto& entry : range) {
+      ASSERT_LE(lo, entry.first);
+      ASSERT_LT(entry.first, hi);
+    }
+  }
+}
+
+TEST(MultiMapTest, EmptyMap) {
+  const std::vector<std::pair<uint64_t, uint64_t>> entries;
+  const rs::MultiMap<uint64_t, uint64_t> map(entries.begin(), entries.end());
+  EXPECT_EQ(map.end(), map.lower_bound(42));
+  EXPECT_EQ(map.end(), map.upper_bound(42));
+  EXPECT_EQ(0u, map.count(42));
+  EXPECT_TRUE(map.range(0, 100).empty());
+}
+
+TEST(MultiMapTest, SplitStorage) {
+  const auto entries = CreateDuplicateRuns();
+  const rs::MultiMap<uint64_t, uint64_t> pairs(entries.begin(), entries.end(),
+                                               18, 8);
+  const rs::MultiMap<uint64_t, uint64_t, rs::BinarySearch, rs::SplitStorage>
+      split(entries.begin(), entries.end(), 18, 8);
+  ASSERT_EQ(pairs.size(), split.size());
+  ASSERT_TRUE(std::equal(pairs.begin(), pairs.end(), split.begin(),
+                         [](const std::pair<uint64_t, uint64_t>& lhs,
+                            const std::pair<uint64_t, uint64_t>& rhs) {
+                           return lhs == rhs;
+                         }));
+
+  std::vector<uint64_t> lookup_keys;
+  for (uint64_t key = 0; key <= 100001; key += 3) lookup_keys.push_back(key);
+  std::vector<decltype(split.begin())> results(lookup_keys.size());
+  split.lower_bound_batch(lookup_keys.data(), lookup_keys.size(),
+                          results.data());
+  for (size_t i = 0; i < lookup_keys.size(); ++i) {
+    const uint64_t key = lookup_keys[i];
+    const auto iter = split.lower_bound(key);
+    ASSERT_EQ(pairs.lower_bound(key) - pairs.begin(), iter - split.begin());
+    ASSERT_EQ(iter, results[i]);
+    if (iter != split.end()) {
+      ASSERT_EQ(pairs.lower_bound(key)->first, iter->first);
+      ASSERT_EQ(pairs.lower_bound(key)->second, (*iter).second);
+    }
+    ASSERT_EQ(pairs.find(key) - pairs.begin(), split.find(key) - split.begin());
+    ASSERT_EQ(pairs.count(key), split.count(key));
+    ASSERT_EQ(pairs.range(key, key + 100).size(),
+              split.range(key, key + 100).size());
+  }
+}
+
+TEST(MultiMapTest, RangeForEach) {
+  const auto entries = CreateDuplicateRuns();
+  const rs::MultiMap<uint64_t, uint64_t> pairs(entries.begin(), entries.end(),
+                                               18, 8);
+  const rs::MultiMap<uint64_t, uint64_t, rs::BinarySearch, rs::SplitStorage>
+      split(entries.begin(), entries.end(), 18, 8);
+
+  // Ranges of all lengths, including empty ones and the entire map.
+  for (const uint64_t length : {0, 1, 7, 100, 5000, 200000}) {
+    for (uint64_t lo = 0; lo <= 100001; lo += 997) {
+      const auto range = pairs.range(lo, lo + length);
+      uint64_t expected_key_sum = 0;
+      uint64_t expected_value_sum = 0;
+      for (const auto& entry : range) {
+        expected_key_sum += entry.first;
+        expected_value_sum += entry.second;
+      }
+      uint64_t last_key = 0;
+      size_t size = 0;
+      uint64_t key_sum = 0;
+      uint64_t value_sum = 0;
+      range.ForEach([&](uint64_t key, uint64_t value) {
+        ASSERT_LE(last_key, key);
+        last_key = key;
+        ++size;
+        key_sum += key;
+        value_sum += value;
+      });
+      ASSERT_EQ(range.size(), size);
+      ASSERT_EQ(expected_key_sum, key_sum);
+      ASSERT_EQ(expected_value_sum, value_sum);
+
+      key_sum = 0;
+      value_sum = 0;
+      split.range(lo, lo + length).ForEach([&](uint64_t key, uint64_t value) {
+        key_sum += key;
+        value_sum += value;
+      });
+      ASSERT_EQ(expected_key_sum, key_sum);
+      ASSERT_EQ(expected_value_sum, value_sum);
+    }
+  }
+}
+
+TEST(MultiMapTest, SplitStorageIterator) {
+  struct Wide {
+    uint64_t payload[8];
+  };
+  std::vector<std::pair<uint32_t, Wide>> entries;
+  for (uint32_t key = 0; key < 100; ++key)
+    entries.emplace_back(2 * key, Wide{{key}});
+  const rs::MultiMap<uint32_t, Wide, rs::LinearSearch, rs::SplitStorage> map(
+      entries.begin(), entries.end());
+
+  auto iter = map.find(42);
+  ASSERT_NE(map.end(), iter);
+  EXPECT_EQ(21u, iter->second.payload[0]);
+  EXPECT_EQ(20u, iter[-1].second.payload[0]);
+  EXPECT_EQ(22u, (iter + 1)->second.payload[0]);
+  EXPECT_EQ(44u, (*++iter).first);
+  EXPECT_EQ(44u, (iter--)->first);
+  EXPECT_EQ(42u, iter->first);
+  EXPECT_EQ(100, map.end() - map.begin());
+  EXPECT_TRUE(map.begin() < iter && iter <= map.end());
+  EXPECT_EQ(map.end(), map.find(43));
+
+  // Converts to the element type.
+  const std::pair<uint32_t, Wide> element = *map.begin();
+  EXPECT_EQ(0u, element.first);
+
+  size_t num_elements = 0;
+  for (const auto& entry : map.range(10, 20)) {
+    EXPECT_EQ(entry.first / 2, entry.second.payload[0]);
+    ++num_elements;
+  }
+  EXPECT_EQ(5u, num_elements);
+}
+
+TEST(MultiMapTest, AdoptVector) {
+  // Unsorted keys with duplicates, in input order among equal keys.
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  std::mt19937 randomness_generator(7);
+  std::uniform_int_distribution<uint64_t> distribution(0, 1000);
+  for (size_t i = 0; i < 200000; ++i)
+    entries.emplace_back(distribution(randomness_generator), i);
+  const std::multimap<uint64_t, uint64_t> ref(entries.begin(), entries.end());
+
+  auto copy = entries;
+  const rs::MultiMap<uint64_t, uint64_t> adopted(std::move(copy), 18, 8,
+                                                 /*num_threads=*/4);
+  const rs::MultiMap<uint64_t, uint64_t> copied(entries.begin(),
+                                                entries.end(), 18, 8);
+  ASSERT_EQ(ref.size(), adopted.size());
+  const auto equal = [](const std::pair<const uint64_t, uint64_t>& lhs,
+                        const std::pair<uint64_t, uint64_t>& rhs) {
+    return lhs.first == rhs.first && lhs.second == rhs.second;
+  };
+  ASSERT_TRUE(std::equal(ref.begin(), ref.end(), adopted.begin(), equal));
+  ASSERT_TRUE(std::equal(ref.begin(), ref.end(), copied.begin(), equal));
+  for (uint64_t key = 0; key <= 1001; ++key)
+    ASSERT_EQ(ref.count(key), adopted.count(key)) << "key: " << key;
+
+  // Values without a default constructor are sorted with a comparison sort.
+  struct Value {
+    explicit Value(char c) : c(c) {}
+    char c;
+  };
+  std::vector<std::pair<uint64_t, Value>> values;
+  values.emplace_back(3, Value('c'));
+  values.emplace_back(1, Value('a'));
+  values.emplace_back(2, Value('b'));
+  const rs::MultiMap<uint64_t, Value> value_map(std::move(values));
+  EXPECT_EQ('a', value_map.begin()->second.c);
+  EXPECT_EQ('b', value_map.find(2)->second.c);
+}
+
+TEST(MultiMapTest, HugePages) {
+  // Large enough for huge pages in both storages.
+  std::vector<std::pair<uint64_t, uint64_t>> entries;
+  for (uint64_t i = 0; i < 400000; ++i) entries.emplace_back(3 * i, i);
+  const rs::MultiMap<uint64_t, uint64_t> map(entries.begin(), entries.end(),
+                                             20, 8);
+  const rs::MultiMap<uint64_t, uint64_t> huge_pairs(
+      entries.begin(), entries.end(), 20, 8, /*num_threads=*/1,
+      rs::HugePages::kTransparent);
+  const rs::MultiMap<uint64_t, uint64_t, rs::BinarySearch, rs::SplitStorage>
+      huge_split(entries.begin(), entries.end(), 20, 8, /*num_threads=*/1,
+                 rs::HugePages::kExplicit);
+  ASSERT_EQ(map.size(), huge_pairs.size());
+  ASSERT_EQ(map.size(), huge_split.size());
+  EXPECT_EQ(map.GetIndexSize(), huge_pairs.GetIndexSize());
+
+  for (uint64_t key = 0; key <= 3 * entries.size(); key += 7) {
+    const size_t position = map.lower_bound(key) - map.begin();
+    ASSERT_EQ(position, huge_pairs.lower_bound(key) - huge_pairs.begin());
+    ASSERT_EQ(position, huge_split.lower_bound(key) - huge_split.begin());
+    if (position < map.size()) {
+      ASSERT_EQ(map.lower_bound(key)->second,
+                huge_split.lower_bound(key)->second);
+    }
+  }
+}
+
+}  // namespace
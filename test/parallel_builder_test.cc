@@ -0,0 +1,124 @@
+#include "include/rs/parallel_builder.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "include/rs/builder.h"
+
+namespace {
+
+const size_t kNumKeys = 10000;
+const size_t kNumRadixBits = 12;
+const size_t kMaxError = 8;
+
+// Creates random keys with many duplicates.
+template <class KeyType>
+std::vector<KeyType> CreateKeysWithDuplicates(size_t seed) {
+  std::mt19937 g(seed);
+  std::uniform_int_distribution<KeyType> d(std::numeric_limits<KeyType>::min(),
+                                           std::numeric_limits<KeyType>::max());
+  std::vector<KeyType> keys;
+  keys.reserve(kNumKeys);
+  while (keys.size() < kNumKeys) {
+    const KeyType key = d(g);
+    const size_t num_duplicates = 1 + g() % 4;
+    for (size_t i = 0; i < num_duplicates; ++i) keys.push_back(key);
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+template <class KeyType>
+void ExpectKeysWithinBounds(const rs::RadixSpline<KeyType>& rs,
+                            const std::vector<KeyType>& keys) {
+  for (const auto& key : keys) {
+    const rs::SearchBound bound = rs.GetSearchBound(key);
+    const size_t position =
+        std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+    ASSERT_LE(bound.begin, position) << "key: " << key;
+    ASSERT_GT(bound.end, position) << "key: " << key;
+  }
+}
+
+template <class T>
+struct ParallelBuilderTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(ParallelBuilderTest, AllKeyTypes);
+
+TYPED_TEST(ParallelBuilderTest, SingleThreadMatchesBuilder) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateKeysWithDuplicates<KeyType>(/*seed=*/42);
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), kNumRadixBits,
+                           kMaxError);
+  for (const auto& key : keys) rsb.AddKey(key);
+  const auto expected = rsb.Finalize();
+
+  const auto rs = rs::ParallelBuilder<KeyType>(/*num_threads=*/1,
+                                               kNumRadixBits, kMaxError)
+                      .Build(keys.data(), keys.size());
+  EXPECT_EQ(expected.GetSize(), rs.GetSize());
+  for (const auto& key : keys)
+    ASSERT_EQ(expected.GetEstimatedPosition(key), rs.GetEstimatedPosition(key));
+}
+
+TYPED_TEST(ParallelBuilderTest, KeepsMaxError) {
+  using KeyType = typename TestFixture::KeyType;
+  for (size_t seed = 0; seed < 3; ++seed) {
+    const auto keys = CreateKeysWithDuplicates<KeyType>(seed);
+    for (const size_t num_threads : {2, 3, 8, 64}) {
+      for (const auto spline_layout :
+           {rs::SplineLayout::kCompact, rs::SplineLayout::kPrecomputedSlopes}) {
+        const auto rs =
+            rs::ParallelBuilder<KeyType>(num_threads, kNumRadixBits, kMaxError,
+                                         spline_layout,
+                                         rs::RadixTableEncoding::kCompressed)
+                .Build(keys.data(), keys.size());
+        ExpectKeysWithinBounds(rs, keys);
+      }
+    }
+  }
+}
+
+TYPED_TEST(ParallelBuilderTest, PerSegmentErrorBounds) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateKeysWithDuplicates<KeyType>(/*seed=*/42);
+  for (const size_t num_threads : {1, 2, 3, 8, 64}) {
+    const auto rs =
+        rs::ParallelBuilder<KeyType>(num_threads, kNumRadixBits, kMaxError,
+                                     rs::SplineLayout::kCompact,
+                                     rs::RadixTableEncoding::kPlain,
+                                     rs::ErrorBounds::kPerSegment)
+            .Build(keys.data(), keys.size());
+    ExpectKeysWithinBounds(rs, keys);
+
+    // Same spline as with global bounds, but never wider bounds.
+    const auto global = rs::ParallelBuilder<KeyType>(num_threads,
+                                                     kNumRadixBits, kMaxError)
+                            .Build(keys.data(), keys.size());
+    EXPECT_LT(global.GetSize(), rs.GetSize());
+    for (const auto& key : keys) {
+      ASSERT_EQ(global.GetEstimatedPosition(key), rs.GetEstimatedPosition(key));
+      const rs::SearchBound bound = rs.GetSearchBound(key);
+      const rs::SearchBound global_bound = global.GetSearchBound(key);
+      ASSERT_LE(global_bound.begin, bound.begin) << "key: " << key;
+      ASSERT_GE(global_bound.end, bound.end) << "key: " << key;
+    }
+  }
+}
+
+TYPED_TEST(ParallelBuilderTest, FewDistinctKeys) {
+  using KeyType = typename TestFixture::KeyType;
+  // More threads than distinct keys.
+  const std::vector<KeyType> keys = {1, 1, 1, 5, 5, 7, 9, 9, 9, 9, 9, 12};
+  for (const size_t num_threads : {1, 2, 4, 16}) {
+    const auto rs = rs::ParallelBuilder<KeyType>(num_threads, kNumRadixBits,
+                                                 /*max_error=*/1)
+                        .Build(keys.data(), keys.size());
+    ExpectKeysWithinBounds(rs, keys);
+  }
+}
+
+}  // namespace
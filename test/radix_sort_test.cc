@@ -0,0 +1,74 @@
+#include "include/rs/radix_sort.h"
+
+#include <algorithm>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using Element = std::pair<uint64_t, uint64_t>;
+
+// Returns elements with random keys below `max_key` and their input position
+// as value.
+std::vector<Element> CreateElements(size_t num_elements, uint64_t max_key) {
+  std::mt19937_64 gen(42);
+  std::uniform_int_distribution<uint64_t> distrib(0, max_key);
+  std::vector<Element> elements;
+  for (size_t i = 0; i < num_elements; ++i)
+    elements.emplace_back(distrib(gen), i);
+  return elements;
+}
+
+// Checks `RadixSort` against `std::stable_sort`.
+void CheckSort(std::vector<Element> elements, size_t num_threads) {
+  std::vector<Element> expected = elements;
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Element& lhs, const Element& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  rs::RadixSort(
+      &elements, [](const Element& element) { return element.first; },
+      num_threads);
+  ASSERT_EQ(expected, elements);
+}
+
+TEST(RadixSortTest, Empty) {
+  CheckSort({}, 1);
+  CheckSort({{7, 0}}, 4);
+}
+
+TEST(RadixSortTest, FullKeyRange) {
+  CheckSort(CreateElements(10000, std::numeric_limits<uint64_t>::max()), 1);
+}
+
+TEST(RadixSortTest, SmallKeysAndDuplicates) {
+  // Only the lowest digit differs and most keys have duplicates.
+  CheckSort(CreateElements(10000, 200), 1);
+}
+
+TEST(RadixSortTest, AlreadySorted) {
+  std::vector<Element> elements = CreateElements(10000, 1 << 20);
+  std::sort(elements.begin(), elements.end());
+  CheckSort(elements, 1);
+}
+
+TEST(RadixSortTest, MultipleThreads) {
+  for (const size_t num_threads : {2, 3, 8}) {
+    CheckSort(CreateElements(500000, 1ull << 40), num_threads);
+    CheckSort(CreateElements(500000, 1000), num_threads);
+  }
+}
+
+TEST(RadixSortTest, Keys32) {
+  std::mt19937 gen(7);
+  std::vector<uint32_t> keys(300000);
+  for (uint32_t& key : keys) key = gen();
+  std::vector<uint32_t> expected = keys;
+  std::sort(expected.begin(), expected.end());
+  rs::RadixSort(
+      &keys, [](uint32_t key) { return key; }, 4);
+  ASSERT_EQ(expected, keys);
+}
+
+}  // namespace
@@ -69,14 +69,16 @@ std::vector<KeyType> CreateSkewedKeys(size_t seed) {
 }
 
 template <class KeyType>
-rs::RadixSpline<KeyType> CreateRadixSpline(const std::vector<KeyType>& keys) {
+rs::RadixSpline<KeyType> CreateRadixSpline(
+    const std::vector<KeyType>& keys,
+    rs::SplineLayout spline_layout = rs::SplineLayout::kCompact) {
   auto min = std::numeric_limits<KeyType>::min();
   auto max = std::numeric_limits<KeyType>::max();
   if (keys.size() > 0) {
     min = keys.front();
     max = keys.back();
   }
-  rs::Builder<KeyType> rsb(min, max, kNumRadixBits, kMaxError);
+  rs::Builder<KeyType> rsb(min, max, kNumRadixBits, kMaxError, spline_layout);
   for (const auto& key : keys) rsb.AddKey(key);
   return rsb.Finalize();
 }
@@ -176,6 +178,250 @@ TYPED_TEST(RadixSplineTest, AddAndLookupSkewedKeysNegativeLookups) {
   }
 }
 
+TYPED_TEST(RadixSplineTest, GetSearchBoundsMatchesGetSearchBound) {
+  using KeyType = typename TestFixture::KeyType;
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/i);
+    const auto rs = CreateRadixSpline(keys);
+
+    // Mix positive and negative lookups, including keys out of range.
+    auto lookup_keys = CreateUniqueRandomKeys<KeyType>(/*seed=*/815 + i);
+    lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+    std::shuffle(lookup_keys.begin(), lookup_keys.end(), std::mt19937(i));
+
+    std::vector<rs::SearchBound> bounds(lookup_keys.size());
+    std::vector<double> estimates(lookup_keys.size());
+    rs.GetSearchBounds(lookup_keys.data(), lookup_keys.size(), bounds.data(),
+                       estimates.data());
+    for (size_t j = 0; j < lookup_keys.size(); ++j) {
+      const auto expected = rs.GetSearchBound(lookup_keys[j]);
+      EXPECT_EQ(expected.begin, bounds[j].begin) << "key: " << lookup_keys[j];
+      EXPECT_EQ(expected.end, bounds[j].end) << "key: " << lookup_keys[j];
+      EXPECT_EQ(rs.GetEstimatedPosition(lookup_keys[j]), estimates[j])
+          << "key: " << lookup_keys[j];
+    }
+  }
+}
+
+TYPED_TEST(RadixSplineTest, PrecomputedSlopesMatchCompactLayout) {
+  using KeyType = typename TestFixture::KeyType;
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/i);
+    const auto rs = CreateRadixSpline(keys);
+    const auto rs_slopes =
+        CreateRadixSpline(keys, rs::SplineLayout::kPrecomputedSlopes);
+    EXPECT_GT(rs_slopes.GetSize(), rs.GetSize());
+
+    auto lookup_keys = CreateUniqueRandomKeys<KeyType>(/*seed=*/815 + i);
+    lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+    for (const auto& key : lookup_keys)
+      EXPECT_EQ(rs.GetEstimatedPosition(key),
+                rs_slopes.GetEstimatedPosition(key))
+          << "key: " << key;
+  }
+}
+
+TYPED_TEST(RadixSplineTest, CompressedRadixTableMatchesPlain) {
+  using KeyType = typename TestFixture::KeyType;
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/i);
+    const auto rs = CreateRadixSpline(keys);
+    rs::Builder<KeyType> rsb(keys.front(), keys.back(), kNumRadixBits,
+                             kMaxError, rs::SplineLayout::kCompact,
+                             rs::RadixTableEncoding::kCompressed);
+    for (const auto& key : keys) rsb.AddKey(key);
+    const auto rs_compressed = rsb.Finalize();
+    EXPECT_LT(rs_compressed.GetSize(), rs.GetSize());
+
+    auto lookup_keys = CreateUniqueRandomKeys<KeyType>(/*seed=*/815 + i);
+    lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+    for (const auto& key : lookup_keys)
+      EXPECT_EQ(rs.GetEstimatedPosition(key),
+                rs_compressed.GetEstimatedPosition(key))
+          << "key: " << key;
+  }
+}
+
+TYPED_TEST(RadixSplineTest, HugePagesMatchNormalPages) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/42);
+  // A radix table of 16 MiB, which is backed by huge pages.
+  const size_t num_radix_bits = 22;
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), num_radix_bits,
+                           kMaxError);
+  for (const auto& key : keys) rsb.AddKey(key);
+  const auto rs = rsb.Finalize();
+
+  for (const auto huge_pages :
+       {rs::HugePages::kTransparent, rs::HugePages::kExplicit}) {
+    rs::Builder<KeyType> huge_rsb(
+        keys.front(), keys.back(), num_radix_bits, kMaxError,
+        rs::SplineLayout::kCompact, rs::RadixTableEncoding::kPlain,
+        huge_pages);
+    for (const auto& key : keys) huge_rsb.AddKey(key);
+    const auto huge_rs = huge_rsb.Finalize();
+    // Copies keep the huge pages.
+    const auto huge_rs_copy = huge_rs;
+    EXPECT_EQ(rs.GetSize(), huge_rs.GetSize());
+
+    auto lookup_keys = CreateUniqueRandomKeys<KeyType>(/*seed=*/815);
+    lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+    for (const auto& key : lookup_keys) {
+      EXPECT_EQ(rs.GetEstimatedPosition(key),
+                huge_rs.GetEstimatedPosition(key))
+          << "key: " << key;
+      EXPECT_EQ(rs.GetEstimatedPosition(key),
+                huge_rs_copy.GetEstimatedPosition(key))
+          << "key: " << key;
+    }
+  }
+}
+
+TYPED_TEST(RadixSplineTest, PerSegmentErrorBounds) {
+  using KeyType = typename TestFixture::KeyType;
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/i);
+    // Errors above 255 are stored in larger units.
+    for (const size_t max_error : {kMaxError, size_t{300}}) {
+      rs::Builder<KeyType> rsb(keys.front(), keys.back(), kNumRadixBits,
+                               max_error);
+      for (const auto& key : keys) rsb.AddKey(key);
+      const auto rs = rsb.Finalize();
+      rs::Builder<KeyType> tight_rsb(
+          keys.front(), keys.back(), kNumRadixBits, max_error,
+          rs::SplineLayout::kCompact, rs::RadixTableEncoding::kPlain,
+          rs::HugePages::kNone, rs::ErrorBounds::kPerSegment);
+      tight_rsb.AddKeys(keys.data(), keys.data() + keys.size());
+      const auto tight_rs = tight_rsb.Finalize();
+      EXPECT_GT(tight_rs.GetSize(), rs.GetSize());
+
+      // Same bounds if the keys are added one by one.
+      rs::Builder<KeyType> single_rsb(
+          keys.front(), keys.back(), kNumRadixBits, max_error,
+          rs::SplineLayout::kCompact, rs::RadixTableEncoding::kPlain,
+          rs::HugePages::kNone, rs::ErrorBounds::kPerSegment);
+      for (const auto& key : keys) single_rsb.AddKey(key);
+      const auto single_rs = single_rsb.Finalize();
+
+      // The bounds lie within the global ones and are narrower on average.
+      size_t width = 0;
+      size_t tight_width = 0;
+      for (const auto& key : keys) {
+        const auto bound = rs.GetSearchBound(key);
+        const auto tight_bound = tight_rs.GetSearchBound(key);
+        EXPECT_EQ(rs.GetEstimatedPosition(key),
+                  tight_rs.GetEstimatedPosition(key))
+            << "key: " << key;
+        EXPECT_TRUE(BoundContains(keys, tight_bound, key)) << "key: " << key;
+        EXPECT_LE(bound.begin, tight_bound.begin) << "key: " << key;
+        EXPECT_GE(bound.end, tight_bound.end) << "key: " << key;
+        EXPECT_EQ(tight_bound.begin, single_rs.GetSearchBound(key).begin);
+        EXPECT_EQ(tight_bound.end, single_rs.GetSearchBound(key).end);
+        width += bound.end - bound.begin;
+        tight_width += tight_bound.end - tight_bound.begin;
+      }
+      EXPECT_LT(tight_width, width);
+
+      // Mix positive and negative lookups, including keys out of range.
+      auto lookup_keys = CreateUniqueRandomKeys<KeyType>(/*seed=*/815 + i);
+      lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+      std::vector<rs::SearchBound> bounds(lookup_keys.size());
+      tight_rs.GetSearchBounds(lookup_keys.data(), lookup_keys.size(),
+                               bounds.data());
+      for (size_t j = 0; j < lookup_keys.size(); ++j) {
+        const KeyType key = lookup_keys[j];
+        const auto expected = tight_rs.GetSearchBound(key);
+        EXPECT_EQ(expected.begin, bounds[j].begin) << "key: " << key;
+        EXPECT_EQ(expected.end, bounds[j].end) << "key: " << key;
+        EXPECT_EQ(std::lower_bound(keys.begin(), keys.end(), key) -
+                      keys.begin(),
+                  tight_rs.LowerBound(keys.data(), key))
+            << "key: " << key;
+      }
+    }
+  }
+}
+
+TYPED_TEST(RadixSplineTest, LowerBoundMatchesStdLowerBound) {
+  using KeyType = typename TestFixture::KeyType;
+  for (size_t i = 0; i < kNumIterations; ++i) {
+    const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/i);
+    const auto rs = CreateRadixSpline(keys);
+
+    // Mix positive and negative lookups, including keys out of range.
+    auto lookup_keys = CreateUniqueRandomKeys<KeyType>(/*seed=*/815 + i);
+    lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+    for (const auto& key : lookup_keys) {
+      const size_t expected =
+          std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+      EXPECT_EQ(expected, rs.LowerBound(keys.data(), key)) << "key: " << key;
+      EXPECT_EQ(expected, rs.template LowerBound<rs::BinarySearch>(
+                              keys.data(), key))
+          << "key: " << key;
+    }
+  }
+}
+
+TYPED_TEST(RadixSplineTest, EqualRange) {
+  using KeyType = typename TestFixture::KeyType;
+  // Runs of duplicates that are longer than the error bound.
+  std::vector<KeyType> keys;
+  for (KeyType key = 1; key <= 100; ++key)
+    keys.insert(keys.end(), (key % 10 == 0) ? 10 * kMaxError : 1, key);
+  keys.push_back(1000);
+  const auto rs = CreateRadixSpline(keys);
+
+  using Pair = std::pair<KeyType, int>;
+  std::vector<Pair> elements;
+  for (const auto& key : keys) elements.emplace_back(key, 0);
+  const auto get_key = [](const Pair& element) { return element.first; };
+
+  for (KeyType key = 0; key <= 1001; ++key) {
+    const auto expected = std::equal_range(keys.begin(), keys.end(), key);
+    const std::pair<size_t, size_t> range = rs.EqualRange(keys.data(), key);
+    EXPECT_EQ(expected.first - keys.begin(), range.first) << "key: " << key;
+    EXPECT_EQ(expected.second - keys.begin(), range.second) << "key: " << key;
+    EXPECT_EQ(range, rs.EqualRange(elements.begin(), key, get_key))
+        << "key: " << key;
+    EXPECT_EQ(range.second - range.first, rs.Count(keys.data(), key))
+        << "key: " << key;
+  }
+}
+
+TYPED_TEST(RadixSplineTest, AddKeysMatchesAddKey) {
+  using KeyType = typename TestFixture::KeyType;
+  // Dense, unique, skewed, and duplicated keys.
+  std::vector<std::vector<KeyType>> key_sets = {
+      CreateDenseKeys<KeyType>(), CreateUniqueRandomKeys<KeyType>(/*seed=*/42)};
+  for (size_t i = 0; i < kNumIterations; ++i)
+    key_sets.push_back(CreateSkewedKeys<KeyType>(/*seed=*/i));
+  auto duplicated_keys = key_sets[1];
+  for (size_t i = 0; i < duplicated_keys.size(); i += 3)
+    duplicated_keys.insert(duplicated_keys.begin() + i, duplicated_keys[i]);
+  key_sets.push_back(duplicated_keys);
+
+  rs::Serializer<KeyType> serializer;
+  for (const auto& keys : key_sets) {
+    const auto expected = CreateRadixSpline(keys);
+    std::string expected_bytes;
+    serializer.ToBytes(expected, &expected_bytes);
+
+    // Split the keys into several calls.
+    for (const size_t num_calls : {1, 2, 7}) {
+      rs::Builder<KeyType> rsb(keys.front(), keys.back(), kNumRadixBits,
+                               kMaxError);
+      const size_t step = keys.size() / num_calls + 1;
+      for (size_t begin = 0; begin < keys.size(); begin += step) {
+        const size_t end = std::min(begin + step, keys.size());
+        rsb.AddKeys(keys.data() + begin, keys.data() + end);
+      }
+      std::string bytes;
+      serializer.ToBytes(rsb.Finalize(), &bytes);
+      EXPECT_EQ(expected_bytes, bytes) << "num_calls: " << num_calls;
+    }
+  }
+}
+
 TYPED_TEST(RadixSplineTest, GetEstimatedPosKeyOutOfRange) {
   using KeyType = typename TestFixture::KeyType;
   const std::vector<KeyType> keys = {1, 2, 3};
@@ -188,6 +434,8 @@ TYPED_TEST(RadixSplineTest, NoKey) {
   using KeyType = typename TestFixture::KeyType;
   const std::vector<KeyType> keys;
   const auto rs = CreateRadixSpline(keys);
+  EXPECT_EQ(0u, rs.LowerBound(keys.data(), 42));
+  EXPECT_EQ(0u, rs.Count(keys.data(), 42));
   // We expect the size to be at most the size of rs::RadixSpline and the size
   // of the pre-allocated radix table.
   EXPECT_TRUE(rs.GetSize() <=
@@ -234,6 +482,25 @@ TYPED_TEST(RadixSplineTest, AllMaxKeys) {
       << "key: " << key;
 }
 
+TYPED_TEST(RadixSplineTest, ConstructFromVectors) {
+  using KeyType = typename TestFixture::KeyType;
+  std::vector<KeyType> keys;
+  for (KeyType key = 0; key <= 100; ++key) keys.push_back(key);
+  rs::Builder<KeyType> rsb(0, 100, /*num_radix_bits=*/1, kMaxError);
+  for (const auto& key : keys) rsb.AddKey(key);
+  const auto expected = rsb.Finalize();
+
+  // Prefixes of 6 shift bits, two spline points.
+  const rs::RadixSpline<KeyType> rs(0, 100, keys.size(), 1, 6, kMaxError,
+                                    std::vector<uint32_t>{0, 1, 2},
+                                    {{0, 0}, {100, 100}});
+  EXPECT_EQ(expected.GetSize(), rs.GetSize());
+  for (KeyType key = 0; key <= 101; ++key) {
+    EXPECT_EQ(expected.GetEstimatedPosition(key), rs.GetEstimatedPosition(key))
+        << "key: " << key;
+  }
+}
+
 TYPED_TEST(RadixSplineTest, Serialize) {
   using KeyType = typename TestFixture::KeyType;
   const auto keys = CreateDenseKeys<KeyType>();
@@ -243,7 +510,7 @@ TYPED_TEST(RadixSplineTest, Serialize) {
 
   // Serialize.
   std::string bytes;
-  serializer.ToBytes(rs, &bytes);
+  ASSERT_TRUE(serializer.ToBytes(rs, &bytes));
 
   // Deserialize.
   const auto rs_deserialized = serializer.FromBytes(bytes);
@@ -254,4 +521,36 @@ TYPED_TEST(RadixSplineTest, Serialize) {
               rs_deserialized.GetEstimatedPosition(key));
 }
 
+TYPED_TEST(RadixSplineTest, SerializePrecomputedSlopes) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/42);
+  const auto rs = CreateRadixSpline(keys, rs::SplineLayout::kPrecomputedSlopes);
+
+  std::string bytes;
+  rs::Serializer<KeyType>::ToBytes(rs, &bytes);
+  const auto rs_deserialized = rs::Serializer<KeyType>::FromBytes(
+      bytes, rs::SplineLayout::kPrecomputedSlopes);
+
+  ASSERT_EQ(rs.GetSize(), rs_deserialized.GetSize());
+  for (const auto& key : keys)
+    ASSERT_EQ(rs.GetEstimatedPosition(key),
+              rs_deserialized.GetEstimatedPosition(key));
+}
+
+TYPED_TEST(RadixSplineTest, SerializeRejectsPerSegmentErrorBounds) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateSkewedKeys<KeyType>(/*seed=*/42);
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), /*num_radix_bits=*/18,
+                           /*max_error=*/32, rs::SplineLayout::kCompact,
+                           rs::RadixTableEncoding::kPlain, rs::HugePages::kNone,
+                           rs::ErrorBounds::kPerSegment);
+  for (const auto& key : keys) rsb.AddKey(key);
+  const auto rs = rsb.Finalize();
+
+  // The legacy format has no per-segment errors.
+  std::string bytes = "prefix";
+  EXPECT_FALSE(rs::Serializer<KeyType>::ToBytes(rs, &bytes));
+  EXPECT_EQ("prefix", bytes);
+}
+
 }  // namespace
\ No newline at end of file
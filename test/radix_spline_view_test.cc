@@ -0,0 +1,245 @@
+#include "include/rs/radix_spline_view.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+
+#include "gtest/gtest.h"
+#include "include/rs/builder.h"
+#include "include/rs/mapped_file.h"
+#include "include/rs/serializer.h"
+
+namespace {
+
+const size_t kNumKeys = 1000;
+
+template <class KeyType>
+std::vector<KeyType> CreateRandomKeys(size_t seed) {
+  std::mt19937 g(seed);
+  std::uniform_int_distribution<KeyType> d(std::numeric_limits<KeyType>::min(),
+                                           std::numeric_limits<KeyType>::max());
+  std::vector<KeyType> keys;
+  keys.reserve(kNumKeys);
+  for (size_t i = 0; i < kNumKeys; ++i) keys.push_back(d(g));
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+template <class KeyType>
+rs::RadixSpline<KeyType> CreateRadixSpline(
+    const std::vector<KeyType>& keys, rs::SplineLayout spline_layout,
+    rs::RadixTableEncoding radix_table_encoding) {
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), /*num_radix_bits=*/12,
+                           /*max_error=*/8, spline_layout,
+                           radix_table_encoding);
+  for (const auto& key : keys) rsb.AddKey(key);
+  return rsb.Finalize();
+}
+
+template <class KeyType>
+void ExpectSameEstimates(const rs::RadixSpline<KeyType>& rs,
+                         const rs::RadixSplineView<KeyType>& view,
+                         const std::vector<KeyType>& keys) {
+  auto lookup_keys = CreateRandomKeys<KeyType>(/*seed=*/815);
+  lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+  for (const auto& key : lookup_keys)
+    ASSERT_EQ(rs.GetEstimatedPosition(key), view.GetEstimatedPosition(key))
+        << "key: " << key;
+}
+
+template <class T>
+struct RadixSplineViewTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(RadixSplineViewTest, AllKeyTypes);
+
+TYPED_TEST(RadixSplineViewTest, FromAlignedBytes) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateRandomKeys<KeyType>(/*seed=*/42);
+  for (const auto spline_layout :
+       {rs::SplineLayout::kCompact, rs::SplineLayout::kPrecomputedSlopes}) {
+    for (const auto radix_table_encoding :
+         {rs::RadixTableEncoding::kPlain, rs::RadixTableEncoding::kCompressed}) {
+      const auto rs =
+          CreateRadixSpline(keys, spline_layout, radix_table_encoding);
+      std::string bytes;
+      rs::Serializer<KeyType>::ToAlignedBytes(rs, &bytes);
+      EXPECT_EQ(0u, bytes.size() % rs::kFormatAlignment);
+
+      rs::RadixSplineView<KeyType> view;
+      ASSERT_TRUE(rs::RadixSplineView<KeyType>::FromBytes(
+          bytes.data(), bytes.size(), &view));
+      ExpectSameEstimates(rs, view, keys);
+
+      // Copy the view into an owning model.
+      const rs::RadixSpline<KeyType> copy(view);
+      EXPECT_EQ(rs.GetSize(), copy.GetSize());
+      ExpectSameEstimates(copy, view, keys);
+    }
+  }
+}
+
+TYPED_TEST(RadixSplineViewTest, RejectsInvalidBytes) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateRandomKeys<KeyType>(/*seed=*/42);
+  const auto rs = CreateRadixSpline(keys, rs::SplineLayout::kCompact,
+                                    rs::RadixTableEncoding::kPlain);
+  std::string bytes;
+  rs::Serializer<KeyType>::ToAlignedBytes(rs, &bytes);
+  rs::RadixSplineView<KeyType> view;
+
+  // Truncated.
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      bytes.data(), bytes.size() - 1, &view));
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      bytes.data(), sizeof(rs::FormatHeader) - 1, &view));
+
+  // Wrong magic number.
+  std::string corrupted = bytes;
+  corrupted[0] ^= 1;
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view));
+
+  // Wrong key type.
+  using OtherKeyType =
+      typename std::conditional<sizeof(KeyType) == 4, uint64_t, uint32_t>::type;
+  rs::RadixSplineView<OtherKeyType> other_view;
+  EXPECT_FALSE(rs::RadixSplineView<OtherKeyType>::FromBytes(
+      bytes.data(), bytes.size(), &other_view));
+
+  // Inconsistent contents, also without verifying the checksum.
+  rs::FormatHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  rs::FormatHeader invalid_header = header;
+  invalid_header.num_spline_points = 1;
+  corrupted = bytes;
+  std::memcpy(&corrupted[0], &invalid_header, sizeof(invalid_header));
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view, /*verify_checksum=*/false));
+
+  // The last radix table entry points beyond the spline.
+  corrupted = bytes;
+  const uint32_t entry = header.num_spline_points + 1;
+  std::memcpy(&corrupted[rs::FormatLayout::Compute(rs::FormatSectionSizes{})
+                             .offsets[0] +
+                         (header.num_radix_table_entries - 1) * sizeof(entry)],
+              &entry, sizeof(entry));
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view, /*verify_checksum=*/false));
+}
+
+TYPED_TEST(RadixSplineViewTest, DetectsCorruptedSections) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateRandomKeys<KeyType>(/*seed=*/42);
+  const auto rs = CreateRadixSpline(keys, rs::SplineLayout::kCompact,
+                                    rs::RadixTableEncoding::kPlain);
+  std::string bytes;
+  rs::Serializer<KeyType>::ToAlignedBytes(rs, &bytes);
+  rs::RadixSplineView<KeyType> view;
+
+  // Flip a bit in the first radix table entry, which directly follows the
+  // padded header.
+  std::string corrupted = bytes;
+  corrupted[rs::FormatLayout::Compute(rs::FormatSectionSizes{}).offsets[0]] ^=
+      1;
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view));
+  EXPECT_TRUE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view, /*verify_checksum=*/false));
+}
+
+TYPED_TEST(RadixSplineViewTest, WriteAligned) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateRandomKeys<KeyType>(/*seed=*/42);
+  const auto rs = CreateRadixSpline(keys, rs::SplineLayout::kPrecomputedSlopes,
+                                    rs::RadixTableEncoding::kCompressed);
+  std::string bytes;
+  rs::Serializer<KeyType>::ToAlignedBytes(rs, &bytes);
+  ASSERT_EQ(rs::Serializer<KeyType>::GetAlignedSize(rs), bytes.size());
+
+  std::FILE* file = std::tmpfile();
+  ASSERT_NE(nullptr, file);
+  ASSERT_TRUE(rs::Serializer<KeyType>::WriteAligned(rs, fileno(file)));
+  std::string written(bytes.size() + 1, '\0');
+  std::rewind(file);
+  EXPECT_EQ(bytes.size(), std::fread(&written[0], 1, written.size(), file));
+  std::fclose(file);
+  written.resize(bytes.size());
+  EXPECT_EQ(bytes, written);
+
+  rs::RadixSpline<KeyType> copy;
+  ASSERT_TRUE(rs::Serializer<KeyType>::FromAlignedBytes(written.data(),
+                                                        written.size(), &copy));
+  ExpectSameEstimates(copy, rs.View(), keys);
+}
+
+TYPED_TEST(RadixSplineViewTest, PerSegmentErrorBounds) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateRandomKeys<KeyType>(/*seed=*/42);
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), /*num_radix_bits=*/12,
+                           /*max_error=*/8, rs::SplineLayout::kCompact,
+                           rs::RadixTableEncoding::kPlain, rs::HugePages::kNone,
+                           rs::ErrorBounds::kPerSegment);
+  for (const auto& key : keys) rsb.AddKey(key);
+  const auto rs = rsb.Finalize();
+  std::string bytes;
+  rs::Serializer<KeyType>::ToAlignedBytes(rs, &bytes);
+  ASSERT_EQ(rs::Serializer<KeyType>::GetAlignedSize(rs), bytes.size());
+
+  rs::RadixSplineView<KeyType> view;
+  ASSERT_TRUE(rs::RadixSplineView<KeyType>::FromBytes(bytes.data(),
+                                                      bytes.size(), &view));
+  rs::RadixSpline<KeyType> copy;
+  ASSERT_TRUE(rs::Serializer<KeyType>::FromAlignedBytes(bytes.data(),
+                                                        bytes.size(), &copy));
+  EXPECT_EQ(rs.GetSize(), copy.GetSize());
+  auto lookup_keys = CreateRandomKeys<KeyType>(/*seed=*/815);
+  lookup_keys.insert(lookup_keys.end(), keys.begin(), keys.end());
+  for (const auto& key : lookup_keys) {
+    const auto expected = rs.GetSearchBound(key);
+    EXPECT_EQ(expected.begin, view.GetSearchBound(key).begin);
+    EXPECT_EQ(expected.end, view.GetSearchBound(key).end);
+    EXPECT_EQ(expected.begin, copy.GetSearchBound(key).begin);
+    EXPECT_EQ(expected.end, copy.GetSearchBound(key).end);
+  }
+
+  // The errors are the last section and covered by the checksum.
+  std::string corrupted = bytes;
+  corrupted[bytes.size() - rs::kFormatAlignment] ^= 1;
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view));
+
+  // Version 2 has no per-segment errors.
+  rs::FormatHeader header;
+  std::memcpy(&header, bytes.data(), sizeof(header));
+  header.version = 2;
+  std::memcpy(&corrupted[0], &header, sizeof(header));
+  EXPECT_FALSE(rs::RadixSplineView<KeyType>::FromBytes(
+      corrupted.data(), corrupted.size(), &view, /*verify_checksum=*/false));
+}
+
+TYPED_TEST(RadixSplineViewTest, MappedFile) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateRandomKeys<KeyType>(/*seed=*/42);
+  const auto rs = CreateRadixSpline(keys, rs::SplineLayout::kCompact,
+                                    rs::RadixTableEncoding::kCompressed);
+  std::string bytes;
+  rs::Serializer<KeyType>::ToAlignedBytes(rs, &bytes);
+
+  const std::string path = testing::TempDir() + "radix_spline_view_test.rs";
+  std::ofstream(path, std::ios::binary).write(bytes.data(), bytes.size());
+
+  rs::MappedFile file;
+  ASSERT_TRUE(file.Open(path));
+  rs::RadixSplineView<KeyType> view;
+  ASSERT_TRUE(
+      rs::RadixSplineView<KeyType>::FromBytes(file.data(), file.size(), &view));
+  ExpectSameEstimates(rs, view, keys);
+  file.Close();
+  std::remove(path.c_str());
+}
+
+}  // namespace
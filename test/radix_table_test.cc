@@ -0,0 +1,66 @@
+#include "include/rs/radix_table.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Creates `size` monotonically increasing entries whose steps are at most
+// `max_step`.
+rs::AlignedVector<uint32_t> CreateEntries(size_t size, uint32_t max_step) {
+  std::mt19937 g(42);
+  std::uniform_int_distribution<uint32_t> step(0, max_step);
+  rs::AlignedVector<uint32_t> entries;
+  entries.reserve(size);
+  uint32_t entry = 0;
+  for (size_t i = 0; i < size; ++i) {
+    // Most entries repeat their predecessor.
+    if (g() % 8 == 0) entry += step(g);
+    entries.push_back(entry);
+  }
+  return entries;
+}
+
+void ExpectEncodes(const rs::AlignedVector<uint32_t>& entries,
+                   rs::RadixTableEncoding expected_encoding,
+                   size_t expected_size) {
+  const rs::RadixTable table(entries, rs::RadixTableEncoding::kCompressed);
+  EXPECT_EQ(expected_encoding, table.encoding());
+  EXPECT_EQ(expected_size, table.GetSize());
+  ASSERT_EQ(entries.size(), table.size());
+  for (size_t i = 0; i < entries.size(); ++i)
+    ASSERT_EQ(entries[i], table[i]) << "index: " << i;
+}
+
+size_t NumBlocks(size_t size) {
+  return (size + rs::RadixTable::kBlockSize - 1) / rs::RadixTable::kBlockSize;
+}
+
+TEST(RadixTableTest, Plain) {
+  const auto entries = CreateEntries(1000, 100);
+  const rs::RadixTable table(entries, rs::RadixTableEncoding::kPlain);
+  EXPECT_EQ(rs::RadixTableEncoding::kPlain, table.encoding());
+  EXPECT_EQ(entries.size() * sizeof(uint32_t), table.GetSize());
+  for (size_t i = 0; i < entries.size(); ++i) ASSERT_EQ(entries[i], table[i]);
+}
+
+TEST(RadixTableTest, CompressedWith8BitDeltas) {
+  const size_t size = 1001;
+  ExpectEncodes(CreateEntries(size, 20), rs::RadixTableEncoding::kCompressed,
+                NumBlocks(size) * sizeof(uint32_t) + size * sizeof(uint8_t));
+}
+
+TEST(RadixTableTest, CompressedWith16BitDeltas) {
+  const size_t size = 1001;
+  ExpectEncodes(CreateEntries(size, 1000), rs::RadixTableEncoding::kCompressed,
+                NumBlocks(size) * sizeof(uint32_t) + size * sizeof(uint16_t));
+}
+
+TEST(RadixTableTest, FallsBackToPlain) {
+  const size_t size = 1001;
+  ExpectEncodes(CreateEntries(size, 100000), rs::RadixTableEncoding::kPlain,
+                size * sizeof(uint32_t));
+}
+
+}  // namespace
@@ -0,0 +1,112 @@
+#include "include/rs/search.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "include/rs/multi_map.h"
+
+namespace {
+
+template <class SearchPolicy>
+class SearchTest : public testing::Test {};
+
+using SearchPolicies =
+    testing::Types<rs::BinarySearch, rs::BranchlessBinarySearch,
+                   rs::ExponentialSearch, rs::LinearSearch>;
+TYPED_TEST_CASE(SearchTest, SearchPolicies);
+
+// Compares `SearchPolicy` with `std::lower_bound` on random windows of
+// `elements` and random estimates within them.
+template <class SearchPolicy, class Element, class KeyType, class GetKey>
+void CheckRandomWindows(const std::vector<Element>& elements,
+                        const std::vector<KeyType>& keys,
+                        const GetKey& get_key) {
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<size_t> position_distrib(0, elements.size());
+  std::geometric_distribution<size_t> size_distrib(1.0 / 64);
+  for (size_t i = 0; i < 10000; ++i) {
+    const size_t begin = position_distrib(gen);
+    const size_t end = std::min(elements.size(), begin + size_distrib(gen));
+    const size_t estimate =
+        (begin == end) ? begin
+                       : std::uniform_int_distribution<size_t>(
+                             begin, end - 1)(gen);
+    const KeyType key = keys[position_distrib(gen) % keys.size()] +
+                        static_cast<KeyType>(i % 2);
+
+    const auto first = elements.begin() + begin;
+    const auto last = elements.begin() + end;
+    const auto expected = std::lower_bound(
+        first, last, key, [&](const Element& element, const KeyType& k) {
+          return get_key(element) < k;
+        });
+    const auto actual = SearchPolicy::LowerBound(
+        first, last, elements.begin() + estimate, key, get_key);
+    ASSERT_EQ(expected - elements.begin(), actual - elements.begin())
+        << "window: [" << begin << ", " << end << ") estimate: " << estimate
+        << " key: " << key;
+  }
+}
+
+// Returns sorted random keys with duplicates.
+template <class KeyType>
+std::vector<KeyType> GetSortedKeys(size_t num_keys) {
+  std::mt19937 gen(7);
+  std::uniform_int_distribution<KeyType> distrib(0, 10 * num_keys);
+  std::vector<KeyType> keys(num_keys);
+  for (KeyType& key : keys) key = distrib(gen);
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+TYPED_TEST(SearchTest, PlainKeys32) {
+  const std::vector<uint32_t> keys = GetSortedKeys<uint32_t>(10000);
+  CheckRandomWindows<TypeParam>(keys, keys, rs::KeyIdentity());
+}
+
+TYPED_TEST(SearchTest, PlainKeys64) {
+  const std::vector<uint64_t> keys = GetSortedKeys<uint64_t>(10000);
+  CheckRandomWindows<TypeParam>(keys, keys, rs::KeyIdentity());
+}
+
+TYPED_TEST(SearchTest, KeyValuePairs) {
+  using Element = std::pair<uint64_t, uint64_t>;
+  const std::vector<uint64_t> keys = GetSortedKeys<uint64_t>(10000);
+  std::vector<Element> elements;
+  for (size_t i = 0; i < keys.size(); ++i) elements.emplace_back(keys[i], i);
+  CheckRandomWindows<TypeParam>(
+      elements, keys, [](const Element& element) { return element.first; });
+}
+
+TYPED_TEST(SearchTest, EmptyRange) {
+  const std::vector<uint64_t> keys = {1, 2, 3};
+  const auto result = TypeParam::LowerBound(keys.begin() + 1, keys.begin() + 1,
+                                            keys.begin() + 1, uint64_t{2},
+                                            rs::KeyIdentity());
+  EXPECT_EQ(keys.begin() + 1, result);
+}
+
+TYPED_TEST(SearchTest, MultiMap) {
+  const std::vector<uint64_t> keys = GetSortedKeys<uint64_t>(100000);
+  std::vector<std::pair<uint64_t, uint64_t>> data;
+  for (size_t i = 0; i < keys.size(); ++i) data.emplace_back(keys[i], i);
+  const rs::MultiMap<uint64_t, uint64_t, TypeParam> map(data.begin(),
+                                                        data.end(), 12, 8);
+
+  std::vector<uint64_t> lookup_keys;
+  for (uint64_t key = 0; key <= keys.back() + 1; key += 7)
+    lookup_keys.push_back(key);
+  std::vector<decltype(map.begin())> results(lookup_keys.size());
+  map.lower_bound_batch(lookup_keys.data(), lookup_keys.size(),
+                        results.data());
+
+  for (size_t i = 0; i < lookup_keys.size(); ++i) {
+    const size_t expected =
+        std::lower_bound(keys.begin(), keys.end(), lookup_keys[i]) -
+        keys.begin();
+    ASSERT_EQ(expected, map.lower_bound(lookup_keys[i]) - map.begin());
+    ASSERT_EQ(expected, results[i] - map.begin());
+  }
+}
+
+}  // namespace
@@ -0,0 +1,60 @@
+#include "include/rs/simd_search.h"
+
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+template <class T>
+struct SimdSearchTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(SimdSearchTest, AllKeyTypes);
+
+// Creates `size` sorted keys, possibly with duplicates, that span the entire
+// `KeyType` domain, so that the sign bit of the keys is exercised.
+template <class KeyType>
+std::vector<KeyType> CreateSortedKeys(size_t size, std::mt19937& g) {
+  std::uniform_int_distribution<KeyType> d(std::numeric_limits<KeyType>::min(),
+                                           std::numeric_limits<KeyType>::max());
+  std::vector<KeyType> keys;
+  keys.reserve(size);
+  for (size_t i = 0; i < size; ++i) {
+    // Add some duplicates.
+    keys.push_back((i > 0 && g() % 4 == 0) ? keys.back() : d(g));
+  }
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+TYPED_TEST(SimdSearchTest, LowerBoundMatchesStd) {
+  using KeyType = typename TestFixture::KeyType;
+  std::mt19937 g(42);
+  for (size_t size = 0; size <= 200; ++size) {
+    const auto keys = CreateSortedKeys<KeyType>(size, g);
+
+    std::vector<KeyType> lookup_keys(keys);
+    lookup_keys.push_back(std::numeric_limits<KeyType>::min());
+    lookup_keys.push_back(std::numeric_limits<KeyType>::max());
+    for (size_t i = 0; i < 20; ++i) lookup_keys.push_back(g());
+
+    for (const KeyType key : lookup_keys) {
+      const size_t expected =
+          std::lower_bound(keys.begin(), keys.end(), key) - keys.begin();
+      EXPECT_EQ(expected, rs::simd::LowerBound(keys.data(), keys.size(), key))
+          << "size: " << size << " key: " << key;
+      if (size <= rs::simd::kLinearSearchThreshold) {
+        EXPECT_EQ(expected, rs::simd::CountLess(keys.data(), keys.size(), key))
+            << "size: " << size << " key: " << key;
+      }
+    }
+  }
+}
+
+}  // namespace
@@ -0,0 +1,82 @@
+#include "include/rs/snapshot_handle.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+// Counts destructions and detects use after free.
+struct Snapshot {
+  static constexpr uint64_t kAlive = 0x5ea1ed;
+
+  explicit Snapshot(uint64_t version, std::atomic<size_t>* num_deleted)
+      : version(version), state(kAlive), num_deleted(num_deleted) {}
+  ~Snapshot() {
+    state = 0;
+    ++*num_deleted;
+  }
+
+  const uint64_t version;
+  volatile uint64_t state;
+  std::atomic<size_t>* num_deleted;
+};
+
+TEST(SnapshotHandleTest, PublishDeletesOldSnapshot) {
+  std::atomic<size_t> num_deleted(0);
+  {
+    rs::SnapshotHandle<Snapshot> handle(
+        std::unique_ptr<const Snapshot>(new Snapshot(0, &num_deleted)));
+    rs::SnapshotHandle<Snapshot>::Reader reader(&handle);
+    EXPECT_EQ(0u, reader.Pin()->version);
+    reader.Unpin();
+
+    handle.Publish(
+        std::unique_ptr<const Snapshot>(new Snapshot(1, &num_deleted)));
+    EXPECT_EQ(1u, num_deleted);
+    EXPECT_EQ(1u, reader.Pin()->version);
+    reader.Unpin();
+  }
+  EXPECT_EQ(2u, num_deleted);
+}
+
+TEST(SnapshotHandleTest, ConcurrentReaders) {
+  const size_t kNumReaders = 4;
+  const uint64_t kNumVersions = 1000;
+  std::atomic<size_t> num_deleted(0);
+  rs::SnapshotHandle<Snapshot> handle(
+      std::unique_ptr<const Snapshot>(new Snapshot(0, &num_deleted)));
+
+  std::atomic<bool> done(false);
+  std::atomic<size_t> num_errors(0);
+  std::vector<std::thread> readers;
+  for (size_t i = 0; i < kNumReaders; ++i) {
+    readers.emplace_back([&]() {
+      rs::SnapshotHandle<Snapshot>::Reader reader(&handle);
+      uint64_t last_version = 0;
+      while (!done.load()) {
+        const Snapshot* snapshot = reader.Pin();
+        // Versions never go back and pinned snapshots stay alive.
+        if (snapshot->version < last_version) ++num_errors;
+        last_version = snapshot->version;
+        std::this_thread::yield();
+        if (snapshot->state != Snapshot::kAlive) ++num_errors;
+        reader.Unpin();
+      }
+    });
+  }
+
+  for (uint64_t version = 1; version <= kNumVersions; ++version) {
+    handle.Publish(
+        std::unique_ptr<const Snapshot>(new Snapshot(version, &num_deleted)));
+  }
+  done = true;
+  for (auto& reader : readers) reader.join();
+
+  EXPECT_EQ(0u, num_errors);
+  EXPECT_EQ(kNumVersions, num_deleted);
+}
+
+}  // namespace
@@ -0,0 +1,92 @@
+#include "include/rs/static_radix_spline.h"
+
+#include <random>
+#include <type_traits>
+
+#include "gtest/gtest.h"
+#include "include/rs/builder.h"
+
+namespace {
+
+template <class KeyType>
+std::vector<KeyType> CreateSortedKeys(size_t num_keys, size_t seed) {
+  std::mt19937 gen(seed);
+  std::lognormal_distribution<double> distrib(/*mean=*/0, /*stddev=*/2);
+  std::vector<KeyType> keys;
+  for (size_t i = 0; i < num_keys; ++i) keys.push_back(distrib(gen) * 1e6);
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+template <class KeyType>
+rs::RadixSpline<KeyType> Build(const std::vector<KeyType>& keys,
+                               size_t num_radix_bits, size_t max_error) {
+  rs::Builder<KeyType> rsb(keys.front(), keys.back(), num_radix_bits,
+                           max_error);
+  rsb.AddKeys(keys.data(), keys.data() + keys.size());
+  return rsb.Finalize();
+}
+
+template <class T>
+struct StaticRadixSplineTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(StaticRadixSplineTest, AllKeyTypes);
+
+TYPED_TEST(StaticRadixSplineTest, MatchesRuntimeSpline) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateSortedKeys<KeyType>(100000, /*seed=*/42);
+  const auto runtime_rs = Build(keys, 12, 4);
+  const rs::StaticRadixSpline<KeyType, 12, 4> static_rs(runtime_rs);
+
+  const auto lookup_keys = CreateSortedKeys<KeyType>(10000, /*seed=*/815);
+  for (const std::vector<KeyType>* set : {&keys, &lookup_keys}) {
+    for (const KeyType key : *set) {
+      const auto expected_bound = runtime_rs.GetSearchBound(key);
+      const auto bound = static_rs.GetSearchBound(key);
+      ASSERT_EQ(expected_bound.begin, bound.begin) << "key: " << key;
+      ASSERT_EQ(expected_bound.end, bound.end) << "key: " << key;
+      ASSERT_EQ(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin(),
+                static_rs.LowerBound(keys.data(), key))
+          << "key: " << key;
+    }
+  }
+}
+
+TYPED_TEST(StaticRadixSplineTest, FewKeys) {
+  using KeyType = typename TestFixture::KeyType;
+  const std::vector<KeyType> keys = {1, 3, 3, 5, 8};
+  const auto runtime_rs = Build(keys, 18, 32);
+  const rs::StaticRadixSpline<KeyType, 18, 32> static_rs(runtime_rs);
+  for (KeyType key = 0; key <= 9; ++key)
+    EXPECT_EQ(std::lower_bound(keys.begin(), keys.end(), key) - keys.begin(),
+              static_rs.LowerBound(keys.data(), key))
+        << "key: " << key;
+}
+
+TYPED_TEST(StaticRadixSplineTest, DispatchStatic) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateSortedKeys<KeyType>(10000, /*seed=*/7);
+  using Configs = rs::StaticConfigList<rs::StaticConfig<12, 4>,
+                                       rs::StaticConfig<18, 32>>;
+
+  for (const size_t max_error : {4, 32, 5}) {
+    bool is_static = false;
+    rs::DispatchStatic<Configs>(
+        Build(keys, max_error == 4 ? 12 : 18, max_error),
+        [&](const auto& spline) {
+          is_static = !std::is_same<std::decay_t<decltype(spline)>,
+                                    rs::RadixSpline<KeyType>>::value;
+          for (const KeyType key : keys) {
+            ASSERT_EQ(std::lower_bound(keys.begin(), keys.end(), key) -
+                          keys.begin(),
+                      spline.LowerBound(keys.data(), key));
+          }
+        });
+    EXPECT_EQ(max_error != 5, is_static) << "max_error: " << max_error;
+  }
+}
+
+}  // namespace
@@ -0,0 +1,92 @@
+#include "include/rs/tuner.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+#include "include/rs/builder.h"
+
+namespace {
+
+const size_t kNumKeys = 10000;
+
+template <class KeyType>
+std::vector<KeyType> CreateLognormalKeys(size_t seed) {
+  std::mt19937 g(seed);
+  std::lognormal_distribution<double> d(/*mean=*/0, /*stddev=*/2);
+  std::vector<KeyType> keys;
+  keys.reserve(kNumKeys);
+  for (size_t i = 0; i < kNumKeys; ++i) keys.push_back(d(g) * 1e5);
+  std::sort(keys.begin(), keys.end());
+  return keys;
+}
+
+template <class T>
+struct TunerTest : public testing::Test {
+  using KeyType = T;
+};
+
+using AllKeyTypes = testing::Types<uint32_t, uint64_t>;
+TYPED_TEST_SUITE(TunerTest, AllKeyTypes);
+
+TYPED_TEST(TunerTest, EstimatesSizeWithoutSampling) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateLognormalKeys<KeyType>(/*seed=*/42);
+  const rs::Tuner<KeyType> tuner(keys.data(), keys.size());
+  ASSERT_FALSE(tuner.GetConfigs().empty());
+  for (const rs::TuningConfig& config : tuner.GetConfigs()) {
+    if (config.num_radix_bits > 16) continue;
+    rs::Builder<KeyType> rsb(keys.front(), keys.back(), config.num_radix_bits,
+                             config.max_error);
+    for (const auto& key : keys) rsb.AddKey(key);
+    EXPECT_EQ(rsb.Finalize().GetSize(), config.size_in_bytes)
+        << "num_radix_bits: " << config.num_radix_bits
+        << " max_error: " << config.max_error;
+  }
+}
+
+TYPED_TEST(TunerTest, ParetoConfigs) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateLognormalKeys<KeyType>(/*seed=*/42);
+  const rs::Tuner<KeyType> tuner(keys.data(), keys.size(),
+                                 /*max_sample_size=*/1000);
+  const auto& pareto_configs = tuner.GetParetoConfigs();
+  ASSERT_FALSE(pareto_configs.empty());
+  for (size_t i = 1; i < pareto_configs.size(); ++i) {
+    EXPECT_LT(pareto_configs[i - 1].size_in_bytes,
+              pareto_configs[i].size_in_bytes);
+    EXPECT_GT(pareto_configs[i - 1].latency_ns, pareto_configs[i].latency_ns);
+  }
+  // No config is both smaller and faster than a Pareto-optimal one.
+  for (const rs::TuningConfig& config : tuner.GetConfigs()) {
+    for (const rs::TuningConfig& pareto_config : pareto_configs) {
+      EXPECT_FALSE(config.size_in_bytes < pareto_config.size_in_bytes &&
+                   config.latency_ns < pareto_config.latency_ns);
+    }
+  }
+}
+
+TYPED_TEST(TunerTest, TuneForMemoryBudgetAndLatency) {
+  using KeyType = typename TestFixture::KeyType;
+  const auto keys = CreateLognormalKeys<KeyType>(/*seed=*/42);
+  const rs::Tuner<KeyType> tuner(keys.data(), keys.size());
+  const auto& pareto_configs = tuner.GetParetoConfigs();
+  rs::TuningConfig config;
+
+  // The smallest model is the slowest one.
+  ASSERT_TRUE(tuner.TuneForMemoryBudget(pareto_configs.front().size_in_bytes,
+                                        &config));
+  EXPECT_EQ(pareto_configs.front().size_in_bytes, config.size_in_bytes);
+  EXPECT_FALSE(tuner.TuneForMemoryBudget(
+      pareto_configs.front().size_in_bytes - 1, &config));
+
+  // The fastest model is the largest one.
+  ASSERT_TRUE(tuner.TuneForLatency(pareto_configs.back().latency_ns, &config));
+  EXPECT_EQ(pareto_configs.back().size_in_bytes, config.size_in_bytes);
+  EXPECT_FALSE(
+      tuner.TuneForLatency(pareto_configs.back().latency_ns / 2, &config));
+
+  ASSERT_TRUE(tuner.TuneForMemoryBudget(1 << 20, &config));
+  EXPECT_LE(config.size_in_bytes, 1u << 20);
+}
+
+}  // namespace
@@ -0,0 +1,109 @@
+#include "include/rs/updatable_multi_map.h"
+
+#include <map>
+#include <random>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using Map = rs::UpdatableMultiMap<uint64_t, uint64_t>;
+using ReferenceMap = std::multimap<uint64_t, uint64_t>;
+
+void ExpectSameElements(const ReferenceMap& expected, const Map& map) {
+  ASSERT_EQ(expected.size(), map.size());
+  auto iter = map.begin();
+  for (const auto& element : expected) {
+    ASSERT_NE(map.end(), iter);
+    EXPECT_EQ(element.first, iter->first);
+    EXPECT_EQ(element.second, iter->second);
+    ++iter;
+  }
+  EXPECT_EQ(map.end(), iter);
+}
+
+TEST(UpdatableMultiMapTest, InsertAndErase) {
+  std::vector<std::pair<uint64_t, uint64_t>> data = {{1, 10}, {7, 70}, {7, 71},
+                                                     {42, 420}};
+  Map map(data.begin(), data.end());
+
+  map.insert({5, 50});
+  map.insert({7, 72});
+  EXPECT_EQ(6u, map.size());
+  EXPECT_EQ(5u, map.find(5)->first);
+  EXPECT_EQ(3u, map.count(7));
+  EXPECT_EQ(7u, map.lower_bound(6)->first);
+  EXPECT_EQ(70u, map.lower_bound(6)->second);
+
+  // Erase base and delta elements.
+  EXPECT_EQ(3u, map.erase(7));
+  EXPECT_EQ(0u, map.erase(7));
+  EXPECT_EQ(map.end(), map.find(7));
+  EXPECT_EQ(42u, map.lower_bound(6)->first);
+  EXPECT_EQ(3u, map.size());
+
+  // Reinsert an erased key.
+  map.insert({7, 73});
+  EXPECT_EQ(1u, map.count(7));
+  EXPECT_EQ(73u, map.find(7)->second);
+
+  ExpectSameElements({{1, 10}, {5, 50}, {7, 73}, {42, 420}}, map);
+}
+
+TEST(UpdatableMultiMapTest, EmptyBase) {
+  std::vector<std::pair<uint64_t, uint64_t>> data;
+  Map map(data.begin(), data.end(), /*num_radix_bits=*/18, /*max_error=*/32,
+          /*max_delta_size=*/4);
+  EXPECT_EQ(map.end(), map.find(1));
+  for (uint64_t key = 0; key < 10; ++key) map.insert({key, key});
+  map.WaitForMerge();
+  for (uint64_t key = 0; key < 10; ++key) EXPECT_EQ(1u, map.erase(key));
+  map.WaitForMerge();
+  EXPECT_EQ(0u, map.size());
+  EXPECT_EQ(map.begin(), map.end());
+}
+
+TEST(UpdatableMultiMapTest, MatchesStdMultiMap) {
+  std::mt19937 g(42);
+  std::uniform_int_distribution<uint64_t> key_distribution(0, 2000);
+
+  // Start with sorted data, so that equal keys keep their order.
+  std::vector<std::pair<uint64_t, uint64_t>> data;
+  for (uint64_t i = 0; i < 1000; ++i) data.push_back({key_distribution(g), i});
+  std::stable_sort(data.begin(), data.end(),
+                   [](const std::pair<uint64_t, uint64_t>& lhs,
+                      const std::pair<uint64_t, uint64_t>& rhs) {
+                     return lhs.first < rhs.first;
+                   });
+  Map map(data.begin(), data.end(), /*num_radix_bits=*/8, /*max_error=*/4,
+          /*max_delta_size=*/64);
+  ReferenceMap expected(data.begin(), data.end());
+
+  for (uint64_t i = 0; i < 5000; ++i) {
+    const uint64_t key = key_distribution(g);
+    if (g() % 3 == 0) {
+      ASSERT_EQ(expected.erase(key), map.erase(key));
+    } else {
+      map.insert({key, i});
+      expected.insert({key, i});
+    }
+
+    const uint64_t lookup_key = key_distribution(g);
+    const auto expected_iter = expected.lower_bound(lookup_key);
+    const auto iter = map.lower_bound(lookup_key);
+    if (expected_iter == expected.end()) {
+      ASSERT_EQ(map.end(), iter);
+    } else {
+      ASSERT_NE(map.end(), iter);
+      ASSERT_EQ(expected_iter->first, iter->first);
+      ASSERT_EQ(expected_iter->second, iter->second);
+    }
+    ASSERT_EQ(expected.count(lookup_key), map.count(lookup_key));
+
+    if (i % 1000 == 0) ExpectSameElements(expected, map);
+  }
+  map.WaitForMerge();
+  ExpectSameElements(expected, map);
+}
+
+}  // namespace
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace util {
+
+// Parses a Linux cpu or node list such as "0-3,8,10-11".
+static std::vector<int> parse_cpu_list(const std::string& cpu_list) {
+  std::vector<int> cpus;
+  std::istringstream in(cpu_list);
+  std::string range;
+  while (std::getline(in, range, ',')) {
+    if (range.empty() || range == "\n") continue;
+    const size_t dash = range.find('-');
+    const int first = std::stoi(range.substr(0, dash));
+    const int last =
+        (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+    for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+  }
+  return cpus;
+}
+
+// Returns the first line of the file at `path`, or an empty string.
+static std::string read_first_line(const std::string& path) {
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  return line;
+}
+
+// Returns the cpus of each NUMA node with at least one cpu, read from sysfs.
+// The online node ids need not be contiguous, e.g., "0,2-3". Falls back to a
+// single node with all hardware threads, e.g., without sysfs.
+static std::vector<std::vector<int>> get_numa_nodes() {
+  std::vector<std::vector<int>> nodes;
+  const std::string node_dir = "/sys/devices/system/node/";
+  for (const int node : parse_cpu_list(read_first_line(node_dir + "online"))) {
+    std::vector<int> cpus = parse_cpu_list(read_first_line(
+        node_dir + "node" + std::to_string(node) + "/cpulist"));
+    if (!cpus.empty()) nodes.push_back(std::move(cpus));
+  }
+  if (nodes.empty()) {
+    nodes.emplace_back();
+    const int num_cpus = std::max(std::thread::hardware_concurrency(), 1u);
+    for (int cpu = 0; cpu < num_cpus; ++cpu) nodes.back().push_back(cpu);
+  }
+  return nodes;
+}
+
+// Pins the calling thread to `cpu`. Returns false if that is not possible.
+static bool pin_thread(int cpu) {
+#ifdef __linux__
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  CPU_SET(cpu, &cpu_set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) ==
+         0;
+#else
+  (void)cpu;
+  return false;
+#endif
+}
+
+}  // namespace util